@@ -0,0 +1,63 @@
+/*------------------------------------------------------------------------
+  Turf: Configurable C++ platform adapter
+  Copyright (c) 2016 Jeff Preshing
+
+  Distributed under the Simplified BSD License.
+  Original location: https://github.com/preshing/turf
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the LICENSE file for more information.
+------------------------------------------------------------------------*/
+
+#ifndef SAMPLES_MEMLOGDECODER_LOGFILE_H
+#define SAMPLES_MEMLOGDECODER_LOGFILE_H
+
+#include <turf/Core.h>
+#include <turf/impl/Trace_MemLog.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+typedef turf::Trace_MemLog::FileHeader FileHeader;
+typedef turf::Trace_MemLog::FileRecord FileRecord;
+
+//---------------------------------------------------------
+// A file written by Trace_MemLog::dumpEntireLogBinary, read back into memory.
+// SynchroTests uses it too, to check that dumps round-trip.
+//---------------------------------------------------------
+struct LogFile {
+    FileHeader header;
+    std::vector<char> stringTable;
+    std::vector<const char*> strings;
+    std::vector<FileRecord> records;
+
+    bool read(FILE* f) {
+        if (fread(&header, sizeof(header), 1, f) != 1)
+            return false;
+        if (header.magic != turf::Trace_MemLog::FileMagic || header.version != turf::Trace_MemLog::FileVersion)
+            return false;
+        stringTable.resize(header.stringTableSize + 1);
+        if (fread(&stringTable[0], 1, header.stringTableSize, f) != header.stringTableSize)
+            return false;
+        stringTable[header.stringTableSize] = 0;
+        for (turf::ureg pos = 0; pos < header.stringTableSize; pos += strlen(&stringTable[pos]) + 1)
+            strings.push_back(&stringTable[pos]);
+        if (strings.size() != header.numStrings)
+            return false;
+        records.resize((turf::ureg) header.numRecords);
+        if (!records.empty() && fread(&records[0], sizeof(FileRecord), records.size(), f) != records.size())
+            return false;
+        for (const FileRecord& record : records) {
+            if (record.msgIndex >= header.numStrings)
+                return false;
+        }
+        return true;
+    }
+
+    double toMicroseconds(turf::u64 ticks) const {
+        return header.ticksPerSecond > 0 ? ticks * 1e6 / header.ticksPerSecond : 0;
+    }
+};
+
+#endif // SAMPLES_MEMLOGDECODER_LOGFILE_H
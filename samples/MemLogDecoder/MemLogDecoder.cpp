@@ -0,0 +1,109 @@
+/*------------------------------------------------------------------------
+  Turf: Configurable C++ platform adapter
+  Copyright (c) 2016 Jeff Preshing
+
+  Distributed under the Simplified BSD License.
+  Original location: https://github.com/preshing/turf
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the LICENSE file for more information.
+------------------------------------------------------------------------*/
+
+#include <turf/Core.h>
+#include "LogFile.h"
+#include <stdio.h>
+#include <string.h>
+#include <map>
+
+using namespace turf::intTypes;
+
+//---------------------------------------------------------
+// Decodes a file written by Trace_MemLog::dumpEntireLogBinary,
+// either to the same text format as Trace_MemLog::dumpEntireLog,
+// or to JSON that can be loaded in chrome://tracing.
+//---------------------------------------------------------
+static void writeText(const LogFile& log, FILE* out) {
+    u64 prev = 0;
+    for (const FileRecord& record : log.records) {
+        if (log.header.ticksPerSecond > 0)
+            fprintf(out, "%14.3f %+10.3f ", log.toMicroseconds(record.time), log.toMicroseconds(record.time - prev));
+        prev = record.time;
+        fprintf(out, "[%" TURF_U64X "] %" TURF_U64X " %" TURF_U64X " %s\n", record.tid, record.param1, record.param2,
+                log.strings[record.msgIndex]);
+    }
+}
+
+static void writeJSONString(const char* str, FILE* out) {
+    fputc('"', out);
+    for (; *str; str++) {
+        unsigned char c = (unsigned char) *str;
+        if (c == '"' || c == '\\')
+            fprintf(out, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(out, "\\u%04x", c);
+        else
+            fputc(c, out);
+    }
+    fputc('"', out);
+}
+
+static void writeChromeJSON(const LogFile& log, FILE* out) {
+    // Chrome wants small integer thread IDs. Number the threads in order of appearance.
+    std::map<u64, ureg> threadNums;
+    fprintf(out, "{\"traceEvents\":[");
+    for (ureg i = 0; i < log.records.size(); i++) {
+        const FileRecord& record = log.records[i];
+        ureg threadNum = threadNums.insert(std::make_pair(record.tid, threadNums.size())).first->second;
+        fprintf(out, "%s\n{\"name\":", i > 0 ? "," : "");
+        writeJSONString(log.strings[record.msgIndex], out);
+        fprintf(out, ",\"ph\":\"i\",\"s\":\"t\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"args\":{\"param1\":\"0x%" TURF_U64X
+                     "\",\"param2\":\"0x%" TURF_U64X "\"}}",
+                (int) threadNum, log.toMicroseconds(record.time), record.param1, record.param2);
+    }
+    fprintf(out, "\n]}\n");
+}
+
+int main(int argc, char** argv) {
+    bool json = false;
+    const char* inPath = NULL;
+    const char* outPath = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-json") == 0)
+            json = true;
+        else if (!inPath)
+            inPath = argv[i];
+        else
+            outPath = argv[i];
+    }
+    if (!inPath) {
+        fprintf(stderr, "usage: MemLogDecoder [-json] <input> [<output>]\n");
+        return 1;
+    }
+
+    FILE* in = fopen(inPath, "rb");
+    if (!in) {
+        fprintf(stderr, "Can't open %s\n", inPath);
+        return 1;
+    }
+    LogFile log;
+    bool ok = log.read(in);
+    fclose(in);
+    if (!ok) {
+        fprintf(stderr, "%s is not a valid Trace_MemLog binary dump\n", inPath);
+        return 1;
+    }
+
+    FILE* out = outPath ? fopen(outPath, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "Can't open %s\n", outPath);
+        return 1;
+    }
+    if (json)
+        writeChromeJSON(log, out);
+    else
+        writeText(log, out);
+    if (outPath)
+        fclose(out);
+    return 0;
+}
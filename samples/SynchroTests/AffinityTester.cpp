@@ -0,0 +1,87 @@
+/*------------------------------------------------------------------------
+  Turf: Configurable C++ platform adapter
+  Copyright (c) 2016 Jeff Preshing
+
+  Distributed under the Simplified BSD License.
+  Original location: https://github.com/preshing/turf
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the LICENSE file for more information.
+------------------------------------------------------------------------*/
+
+#include <turf/Affinity.h>
+#include <turf/Thread.h>
+#include <vector>
+using namespace turf::intTypes;
+
+//---------------------------------------------------------
+// AffinityTester
+// Checks that the topology queries are consistent with each other, and that a thread that pins itself still
+// sees every core afterwards.
+//---------------------------------------------------------
+static bool checkTopology(const turf::Affinity& affinity) {
+    bool ok = true;
+    u32 numCores = affinity.getNumPhysicalCores();
+    ok &= (numCores > 0);
+    u32 numHWThreads = 0;
+    std::vector<bool> domainUsed(affinity.getNumCacheDomains(), false);
+    std::vector<s32> nodes;
+    for (ureg core = 0; core < numCores; core++) {
+        numHWThreads += affinity.getNumHWThreadsForCore(core);
+        u32 domain = affinity.getCacheDomain(core);
+        ok &= (domain < affinity.getNumCacheDomains());
+        if (domain < domainUsed.size())
+            domainUsed[domain] = true;
+        s32 node = affinity.getNumaNode(core);
+        ok &= (node >= -1);
+        bool seen = false;
+        for (ureg i = 0; i < nodes.size(); i++)
+            seen |= (nodes[i] == node);
+        if (!seen && node >= 0)
+            nodes.push_back(node);
+    }
+    ok &= (numHWThreads == affinity.getNumHWThreads());
+    for (ureg i = 0; i < domainUsed.size(); i++)
+        ok &= domainUsed[i];
+    ok &= (affinity.getNumNumaNodes() == (nodes.empty() ? 1 : nodes.size()));
+    return ok;
+}
+
+struct PinnedThreadCheck {
+    const turf::Affinity* affinity;
+    bool ok;
+
+    static turf::Thread::ReturnType TURF_THREAD_STARTCALL run(void* param) {
+        PinnedThreadCheck* self = (PinnedThreadCheck*) param;
+        turf::Affinity affinity;
+        affinity.setAffinity(0, 0);
+        turf::Affinity afterPinning;
+        self->ok = (afterPinning.getNumPhysicalCores() == self->affinity->getNumPhysicalCores()) &&
+                   (afterPinning.getNumHWThreads() == self->affinity->getNumHWThreads());
+        return 0;
+    }
+};
+
+bool testAffinity() {
+    turf::Affinity affinity;
+    bool ok = checkTopology(affinity);
+
+    PinnedThreadCheck check = {&affinity, false};
+    turf::Thread thread(PinnedThreadCheck::run, &check);
+    thread.join();
+    ok &= check.ok;
+
+#if TURF_KERNEL_LINUX
+    std::vector<u32> values;
+    turf::Affinity::parseCPUList("0-3,8,10-11\n", values);
+    static const u32 expected[] = {0, 1, 2, 3, 8, 10, 11};
+    ok &= (values.size() == sizeof(expected) / sizeof(expected[0]));
+    for (ureg i = 0; i < values.size() && i < sizeof(expected) / sizeof(expected[0]); i++)
+        ok &= (values[i] == expected[i]);
+    values.clear();
+    turf::Affinity::parseCPUList("", values);
+    ok &= values.empty();
+#endif
+    return ok;
+}
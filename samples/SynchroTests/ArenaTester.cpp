@@ -0,0 +1,139 @@
+/*------------------------------------------------------------------------
+  Turf: Configurable C++ platform adapter
+  Copyright (c) 2016 Jeff Preshing
+
+  Distributed under the Simplified BSD License.
+  Original location: https://github.com/preshing/turf
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the LICENSE file for more information.
+------------------------------------------------------------------------*/
+
+#include <turf/Arena.h>
+#include <string.h>
+using namespace turf::intTypes;
+
+//---------------------------------------------------------
+// ArenaTester
+// Checks alignment, chunks of their own for oversized allocations, rewinding across chunks, and realloc.
+//---------------------------------------------------------
+static const ureg ChunkSize = 65536;
+
+static bool isFilled(const void* ptr, ureg size, u8 value) {
+    const u8* bytes = (const u8*) ptr;
+    for (ureg i = 0; i < size; i++) {
+        if (bytes[i] != value)
+            return false;
+    }
+    return true;
+}
+
+static bool testArenaAlignment() {
+    turf::Arena arena(ChunkSize);
+    bool ok = true;
+    for (ureg i = 0; i < 100; i++) {
+        ureg alignment = ureg(1) << (i % 9);
+        uptr ptr = (uptr) arena.alloc(i * 3 + 1, alignment);
+        ok &= (ptr != 0 && ptr % alignment == 0);
+        ptr = (uptr) arena.alloc(i + 1);
+        ok &= (ptr != 0 && ptr % (2 * sizeof(void*)) == 0);
+    }
+    return ok;
+}
+
+static bool testArenaOversized() {
+    bool ok = true;
+    {
+        turf::Arena arena(ChunkSize);
+        memset(arena.alloc(100), 1, 100);
+        ok &= (arena.getSystemBytes() == ChunkSize);
+        void* big = arena.alloc(ChunkSize * 3);
+        ok &= (big != NULL);
+        memset(big, 2, ChunkSize * 3);
+        ok &= (arena.getSystemBytes() > ChunkSize * 4);
+        // reset() frees the large chunk, but keeps the first one.
+        arena.reset();
+        ok &= (arena.getSystemBytes() == ChunkSize);
+        memset(arena.alloc(100), 3, 100);
+        ok &= (arena.getSystemBytes() == ChunkSize);
+    }
+    {
+        // If the first chunk was sized for a large allocation, reset() doesn't keep it.
+        turf::Arena arena(ChunkSize);
+        memset(arena.alloc(ChunkSize * 2), 1, ChunkSize * 2);
+        arena.reset();
+        ok &= (arena.getSystemBytes() == 0);
+    }
+    return ok;
+}
+
+static bool testArenaRewind() {
+    turf::Arena arena(ChunkSize);
+    bool ok = true;
+    arena.alloc(100);
+    ureg systemBytes = arena.getSystemBytes();
+    void* first = NULL;
+    {
+        turf::Arena::Scope scope(arena);
+        // Enough to span several chunks.
+        for (ureg i = 0; i < 10; i++) {
+            void* ptr = arena.alloc(ChunkSize / 3);
+            memset(ptr, 1, ChunkSize / 3);
+            if (i == 0)
+                first = ptr;
+        }
+        ok &= (arena.getSystemBytes() > systemBytes);
+    }
+    ok &= (arena.getSystemBytes() == systemBytes);
+    // The arena picks up exactly where the scope began.
+    ok &= (arena.alloc(ChunkSize / 3) == first);
+
+    turf::Arena::Marker marker = arena.getMarker();
+    void* ptr = arena.alloc(ChunkSize);
+    arena.rewind(marker);
+    ok &= (arena.getSystemBytes() == systemBytes);
+    ok &= (arena.alloc(ChunkSize) == ptr);
+    return ok;
+}
+
+static bool testArenaRealloc() {
+    turf::Arena arena(ChunkSize);
+    turf::Arena::Operator op(arena);
+    bool ok = true;
+
+    // The most recent allocation grows and shrinks in place.
+    void* ptr = op.alloc(100);
+    memset(ptr, 1, 100);
+    ok &= (op.realloc(ptr, 1000) == ptr);
+    ok &= isFilled(ptr, 100, 1);
+    ok &= (op.realloc(ptr, 50) == ptr);
+    ok &= (op.alloc(16) == (u8*) ptr + turf::util::align(50, 2 * sizeof(void*)));
+
+    // Anything older is copied.
+    void* older = op.alloc(200);
+    memset(older, 2, 200);
+    op.alloc(10);
+    void* moved = op.realloc(older, 400);
+    ok &= (moved != older && isFilled(moved, 200, 2));
+
+    // The most recent allocation is copied to a new chunk when it can't grow in place.
+    void* last = op.alloc(300);
+    memset(last, 3, 300);
+    void* grown = op.realloc(last, ChunkSize * 2);
+    ok &= (grown != last && isFilled(grown, 300, 3));
+
+    // Freeing the most recent allocation gives its space back.
+    ptr = op.alloc(64);
+    op.free(ptr);
+    ok &= (op.alloc(64) == ptr);
+    return ok;
+}
+
+bool testArena() {
+    bool ok = testArenaAlignment();
+    ok &= testArenaOversized();
+    ok &= testArenaRewind();
+    ok &= testArenaRealloc();
+    return ok;
+}
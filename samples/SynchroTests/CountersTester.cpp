@@ -0,0 +1,109 @@
+/*------------------------------------------------------------------------
+  Turf: Configurable C++ platform adapter
+  Copyright (c) 2016 Jeff Preshing
+
+  Distributed under the Simplified BSD License.
+  Original location: https://github.com/preshing/turf
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the LICENSE file for more information.
+------------------------------------------------------------------------*/
+
+#include <turf/impl/Trace_Counters.h>
+#include <turf/Thread.h>
+#include <turf/Atomic.h>
+using namespace turf::intTypes;
+
+//---------------------------------------------------------
+// CountersTester
+// Threads count events in rounds, and exit between rounds, so later threads reuse the slabs of earlier ones. Part
+// way through each round, a thread registers a new group, so every running thread moves to a bigger slab. Each event
+// must be counted exactly once, whether its thread is still running or has exited.
+//---------------------------------------------------------
+TURF_TRACE_DECLARE(CountersTester, 2)
+TURF_TRACE_DEFINE_BEGIN(CountersTester, 2)
+TURF_TRACE_DEFINE("[CountersTester] first")
+TURF_TRACE_DEFINE("[CountersTester] second")
+TURF_TRACE_DEFINE_END(CountersTester, 2)
+
+// Groups are never unregistered, so the groups registered during the test need counters that outlive it.
+static const ureg NumRounds = 5;
+static turf::TraceGroup::Counter g_lateCounters[NumRounds];
+
+class CountersTester {
+private:
+    static const ureg NumThreads = 4;
+    static const ureg NumEvents = 1000; // Counted by each thread, per round
+    turf::Atomic<ureg> m_numReady;
+
+    struct ThreadArgs {
+        CountersTester* tester;
+        ureg round;
+        ureg threadNum;
+    };
+
+    void waitForAll(ureg count) {
+        m_numReady.fetchAdd(1, turf::AcquireRelease);
+        while (m_numReady.load(turf::Acquire) < count)
+            turf::Thread::yield();
+    }
+
+    void run(ureg round, ureg threadNum) {
+        for (ureg i = 0; i < NumEvents; i++)
+            TURF_TRACE(CountersTester, 0, "first", 0, 0);
+        waitForAll(NumThreads);
+        if (threadNum == 0) {
+            g_lateCounters[round].str = "[CountersTester] late";
+            new turf::TraceGroup("CountersTesterLate", &g_lateCounters[round], 1);
+        }
+        waitForAll(NumThreads * 2);
+        for (ureg i = 0; i <= threadNum; i++) {
+            TURF_TRACE(CountersTester, 1, "second", 0, 0);
+            turf::Trace_Counters::increment(g_lateCounters[round].slot);
+        }
+    }
+
+    static turf::Thread::ReturnType TURF_THREAD_STARTCALL threadStart(void* param) {
+        ThreadArgs* args = (ThreadArgs*) param;
+        args->tester->run(args->round, args->threadNum);
+        return 0;
+    }
+
+public:
+    CountersTester() : m_numReady(0) {
+    }
+
+    bool test() {
+        bool ok = true;
+        turf::Trace_Counters& counters = turf::Trace_Counters::Instance;
+        u64 first = counters.getCount(Trace_CountersTester[0].slot);
+        u64 second = counters.getCount(Trace_CountersTester[1].slot);
+        for (ureg r = 0; r < NumRounds; r++) {
+            m_numReady.storeNonatomic(0);
+            ThreadArgs args[NumThreads];
+            turf::Thread* threads[NumThreads];
+            for (ureg t = 0; t < NumThreads; t++) {
+                args[t].tester = this;
+                args[t].round = r;
+                args[t].threadNum = t;
+                threads[t] = new turf::Thread(threadStart, &args[t]);
+            }
+            for (ureg t = 0; t < NumThreads; t++) {
+                threads[t]->join();
+                delete threads[t];
+            }
+            first += NumThreads * NumEvents;
+            second += NumThreads * (NumThreads + 1) / 2;
+            ok &= (counters.getCount(Trace_CountersTester[0].slot) == first);
+            ok &= (counters.getCount(Trace_CountersTester[1].slot) == second);
+            ok &= (counters.getCount(g_lateCounters[r].slot) == NumThreads * (NumThreads + 1) / 2);
+        }
+        return ok;
+    }
+};
+
+bool testCounters() {
+    CountersTester tester;
+    return tester.test();
+}
@@ -0,0 +1,181 @@
+/*------------------------------------------------------------------------
+  Turf: Configurable C++ platform adapter
+  Copyright (c) 2016 Jeff Preshing
+
+  Distributed under the Simplified BSD License.
+  Original location: https://github.com/preshing/turf
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the LICENSE file for more information.
+------------------------------------------------------------------------*/
+
+#include <turf/Heap.h>
+#include <turf/Thread.h>
+#include <turf/Atomic.h>
+#include <turf/Util.h>
+#include <string.h>
+#include <vector>
+using namespace turf::intTypes;
+
+//---------------------------------------------------------
+// HeapTester
+// Each thread allocates blocks and hands them to the next thread, which resizes some and frees the rest one at a
+// time or in a batch. With several Heap_DL arenas, the threads are spread across arenas, so blocks are routed back
+// to the arena that owns them. Every block is filled with a value that identifies it, so blocks handed out twice,
+// or freed into the wrong arena, are likely to show up as overwritten. Threads come and go in rounds, so with
+// TURF_DLMALLOC_THREAD_CACHE, the blocks left in the caches of exiting threads must find their way back too.
+//---------------------------------------------------------
+#if TURF_USE_DLMALLOC
+static turf::Heap_DL g_testHeap; // Zero-init at global scope. Separate from TurfHeap, so its stats only count this test.
+#define TEST_HEAP TURF_HEAP_DIRECT(g_testHeap)
+#else
+#define TEST_HEAP TURF_HEAP
+#endif
+
+class HeapTester {
+private:
+    static const ureg NumThreads = 6;
+    static const ureg NumBlocks = 400; // Allocated by each thread, per round
+    turf::Atomic<ureg> m_numReady;
+    std::vector<void*> m_blocks[NumThreads];
+    bool m_ok[NumThreads];
+
+    struct ThreadArgs {
+        HeapTester* tester;
+        ureg threadNum;
+    };
+
+    // Mostly small sizes, with some larger ones mixed in.
+    static ureg getSize(ureg threadNum, ureg index) {
+        ureg size = (threadNum * 7 + index * 13) % 256 + 1;
+        return (index % 10 == 0) ? size * 17 : size;
+    }
+
+    static u8 getValue(ureg threadNum, ureg index) {
+        return u8(threadNum * 31 + index + 1);
+    }
+
+    static bool isFilled(const void* ptr, ureg size, u8 value) {
+        const u8* bytes = (const u8*) ptr;
+        for (ureg i = 0; i < size; i++) {
+            if (bytes[i] != value)
+                return false;
+        }
+        return true;
+    }
+
+    void waitForAll(ureg count) {
+        m_numReady.fetchAdd(1, turf::AcquireRelease);
+        while (m_numReady.load(turf::Acquire) < count)
+            turf::Thread::yield();
+    }
+
+    void run(ureg threadNum) {
+        bool ok = true;
+        std::vector<void*>& mine = m_blocks[threadNum];
+        for (ureg i = 0; i < NumBlocks; i++) {
+            ureg size = getSize(threadNum, i);
+            void* ptr = TEST_HEAP.alloc(size);
+            ok &= (ptr != NULL);
+            if (ptr)
+                memset(ptr, getValue(threadNum, i), size);
+            mine[i] = ptr;
+        }
+        waitForAll(NumThreads);
+
+        // Take the blocks allocated by the next thread.
+        ureg other = (threadNum + 1) % NumThreads;
+        std::vector<void*>& theirs = m_blocks[other];
+        std::vector<void*> batch;
+        for (ureg i = 0; i < NumBlocks; i++) {
+            void* ptr = theirs[i];
+            if (!ptr)
+                continue;
+            ureg size = getSize(other, i);
+            ok &= isFilled(ptr, size, getValue(other, i));
+            if (i % 4 == 0) {
+                // Grow or shrink the block, then free it.
+                ureg newSize = (i % 8 == 0) ? size * 3 : size / 2 + 1;
+                ptr = TEST_HEAP.realloc(ptr, newSize);
+                ok &= (ptr != NULL && isFilled(ptr, turf::util::min(size, newSize), getValue(other, i)));
+                TEST_HEAP.free(ptr);
+            } else if (i % 4 == 1) {
+                TEST_HEAP.free(ptr);
+            } else {
+                batch.push_back(ptr);
+            }
+        }
+        TEST_HEAP.freeBatch(&batch[0], batch.size());
+        m_ok[threadNum] = ok;
+    }
+
+    static turf::Thread::ReturnType TURF_THREAD_STARTCALL threadStart(void* param) {
+        ThreadArgs* args = (ThreadArgs*) param;
+        args->tester->run(args->threadNum);
+        return 0;
+    }
+
+    bool runRound() {
+        m_numReady.storeNonatomic(0);
+        ThreadArgs args[NumThreads];
+        turf::Thread* threads[NumThreads];
+        for (ureg t = 0; t < NumThreads; t++) {
+            m_blocks[t].assign(NumBlocks, NULL);
+            m_ok[t] = false;
+            args[t].tester = this;
+            args[t].threadNum = t;
+            threads[t] = new turf::Thread(threadStart, &args[t]);
+        }
+        bool ok = true;
+        for (ureg t = 0; t < NumThreads; t++) {
+            threads[t]->join();
+            delete threads[t];
+            ok &= m_ok[t];
+        }
+        return ok;
+    }
+
+public:
+    HeapTester() : m_numReady(0) {
+    }
+
+    bool test() {
+        static const ureg NumRounds = 8;
+        bool ok = runRound();
+#if TURF_USE_DLMALLOC
+        // Every block was freed, and exiting threads flush their caches, so later rounds must leave the heap exactly
+        // as the first one did.
+        ureg inUseBytes = TEST_HEAP.getStats().inUseBytes;
+#endif
+        for (ureg r = 1; r < NumRounds; r++) {
+#if TURF_USE_DLMALLOC
+            // Return free pages to the OS part way through. The blocks of later rounds reuse them.
+            if (r == NumRounds / 2)
+                TEST_HEAP.trim();
+#endif
+            ok &= runRound();
+        }
+#if TURF_USE_DLMALLOC
+        ok &= (TEST_HEAP.getStats().inUseBytes == inUseBytes);
+#endif
+#if TURF_DLMALLOC_SITE_STATS
+        // Every call site starts from zero, and ends with nothing live.
+        turf::Heap_DL::SiteStats siteStats[16];
+        ureg numSites = TEST_HEAP.getSiteStats(siteStats, 16);
+        ok &= (numSites > 0 && numSites <= 16);
+        for (ureg i = 0; i < numSites && i < 16; i++)
+            ok &= (siteStats[i].liveCount == 0 && siteStats[i].liveBytes == 0 && siteStats[i].totalCount > 0);
+#endif
+#if TURF_DLMALLOC_SAMPLING && TURF_KERNEL_LINUX
+        // Every write to /dev/full fails.
+        ok &= !TEST_HEAP.dumpHeapProfile("/dev/full");
+#endif
+        return ok;
+    }
+};
+
+bool testHeap() {
+    HeapTester tester;
+    return tester.test();
+}
@@ -0,0 +1,111 @@
+/*------------------------------------------------------------------------
+  Turf: Configurable C++ platform adapter
+  Copyright (c) 2016 Jeff Preshing
+
+  Distributed under the Simplified BSD License.
+  Original location: https://github.com/preshing/turf
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the LICENSE file for more information.
+------------------------------------------------------------------------*/
+
+#include <turf/extra/JobDispatcher.h>
+using namespace turf::intTypes;
+
+//---------------------------------------------------------
+// JobDispatcherTester
+// Counts how many times each thread runs, to check that kick() runs every thread, kickOne() runs
+// only the one it names, and submit() runs every spawned thread while the caller carries on.
+// Runs once with the default idle backoff and once with workers that park right away.
+//---------------------------------------------------------
+class JobDispatcherTester {
+private:
+    static const ureg MaxThreads = 8;
+    ureg m_runs[MaxThreads];
+
+    struct AddAction {
+        ureg* runs;
+        ureg amount;
+        void operator()(ureg threadIndex) const {
+            runs[threadIndex] += amount;
+        }
+    };
+
+public:
+    JobDispatcherTester() {
+        clear();
+    }
+
+    void clear() {
+        for (ureg i = 0; i < MaxThreads; i++)
+            m_runs[i] = 0;
+    }
+
+    void run(ureg threadIndex) {
+        m_runs[threadIndex]++;
+    }
+
+    void runOne() {
+        m_runs[0] += 100;
+    }
+
+    bool check(turf::extra::JobDispatcher& dispatcher) {
+        bool ok = true;
+        static const ureg NumKicks = 1000;
+        clear();
+        for (ureg k = 0; k < NumKicks; k++)
+            dispatcher.kick(&JobDispatcherTester::run, *this);
+        for (ureg i = 0; i < MaxThreads; i++)
+            ok &= (m_runs[i] == (i < dispatcher.getNumThreads() ? NumKicks : 0));
+
+        clear();
+        for (ureg k = 0; k < NumKicks; k++)
+            dispatcher.kickOne(k % 4, &JobDispatcherTester::runOne, *this);
+        // Every kickOne ran on thread 0's counter, whichever thread it was.
+        ok &= (m_runs[0] == NumKicks * 100);
+        for (ureg i = 1; i < MaxThreads; i++)
+            ok &= (m_runs[i] == 0);
+
+        clear();
+        dispatcher.setNumSpawnedThreads(2);
+        dispatcher.kick(&JobDispatcherTester::run, *this);
+        ok &= (m_runs[0] == 1 && m_runs[1] == 1 && m_runs[2] == 0);
+        dispatcher.setNumSpawnedThreads(4);
+
+        // Submitted jobs run on threads 1-3 only. Each one waits for the previous.
+        clear();
+        AddAction action = {m_runs, 1};
+        turf::extra::JobDispatcher::Future future;
+        for (ureg k = 0; k < NumKicks; k++) {
+            future = dispatcher.submit(action);
+            m_runs[0] += 2; // The caller's own work, overlapped with the job
+        }
+        future.wait();
+        ok &= future.isReady();
+        ok &= (m_runs[0] == NumKicks * 2);
+        for (ureg i = 1; i < MaxThreads; i++)
+            ok &= (m_runs[i] == (i < 4 ? NumKicks : 0));
+
+        // kick() waits for a pending submit() first.
+        clear();
+        dispatcher.submit(action);
+        dispatcher.kick(action);
+        ok &= (m_runs[0] == 1 && m_runs[1] == 2 && m_runs[3] == 2);
+        return ok;
+    }
+};
+
+bool testJobDispatcher() {
+    bool ok = true;
+    JobDispatcherTester tester;
+    {
+        turf::extra::JobDispatcher dispatcher(4);
+        ok &= tester.check(dispatcher);
+    }
+    {
+        turf::extra::JobDispatcher dispatcher(4, turf::AdaptiveBackoff::Params(0, 0));
+        ok &= tester.check(dispatcher);
+    }
+    return ok;
+}
@@ -0,0 +1,251 @@
+/*------------------------------------------------------------------------
+  Turf: Configurable C++ platform adapter
+  Copyright (c) 2016 Jeff Preshing
+
+  Distributed under the Simplified BSD License.
+  Original location: https://github.com/preshing/turf
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the LICENSE file for more information.
+------------------------------------------------------------------------*/
+
+#include <turf/impl/Trace_MemLog.h>
+#include <turf/Thread.h>
+#include <turf/Atomic.h>
+#include "../MemLogDecoder/LogFile.h"
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+using namespace turf::intTypes;
+
+//---------------------------------------------------------
+// MemLogTester
+// Logs from several threads at once, each tagging its events with its own number and a sequence number, and
+// checks what each policy keeps at the maxPagesPerThread and maxPages limits. Also checks that the iterator merges
+// the threads' events in timestamp order, that a binary dump reads back the same events, and that a text dump has
+// consistent relative times.
+//---------------------------------------------------------
+class MemLogTester {
+private:
+    static const ureg NumEvents = 300; // Logged by each thread
+    static const ureg EventsPerPage = 50;
+    turf::Trace_MemLog m_log;
+    turf::Atomic<ureg> m_numFinished;
+    ureg m_batchSize;
+
+    struct ThreadArgs {
+        MemLogTester* tester;
+        ureg threadNum;
+    };
+
+    static turf::Thread::ReturnType TURF_THREAD_STARTCALL threadStart(void* param) {
+        ThreadArgs* args = (ThreadArgs*) param;
+        MemLogTester* tester = args->tester;
+        for (ureg i = 0; i < NumEvents; i++)
+            tester->m_log.log("event", args->threadNum, i);
+        // Stay alive until the whole batch has logged, so that every thread in it has its own ID.
+        tester->m_numFinished.fetchAdd(1, turf::Relaxed);
+        while (tester->m_numFinished.load(turf::Relaxed) < tester->m_batchSize)
+            turf::Thread::yield();
+        return 0;
+    }
+
+    void runBatch(ureg firstThreadNum, ureg numThreads) {
+        m_numFinished.storeNonatomic(0);
+        m_batchSize = numThreads;
+        std::vector<ThreadArgs> args(numThreads);
+        std::vector<turf::Thread*> threads(numThreads);
+        for (ureg t = 0; t < numThreads; t++) {
+            args[t].tester = this;
+            args[t].threadNum = firstThreadNum + t;
+            threads[t] = new turf::Thread(threadStart, &args[t]);
+        }
+        for (ureg t = 0; t < numThreads; t++) {
+            threads[t]->join();
+            delete threads[t];
+        }
+    }
+
+    // Collects the param2 values logged by each thread, in the order the iterator visits them, and checks that the
+    // iterator visits events in timestamp order.
+    bool collect(ureg numThreads, std::vector<std::vector<ureg> >& sequences) {
+        sequences.assign(numThreads, std::vector<ureg>());
+        bool ok = true;
+#if TURF_TRACE_MEMLOG_TIMESTAMPS
+        bool first = true;
+        turf::Trace_MemLog::Timer::Point prev = 0;
+#endif
+        for (turf::Trace_MemLog::Iterator iter = m_log.begin(); iter != m_log.end(); ++iter) {
+            const turf::Trace_MemLog::Event& evt = *iter;
+#if TURF_TRACE_MEMLOG_TIMESTAMPS
+            ok &= (first || !(evt.time < prev));
+            prev = evt.time;
+            first = false;
+#endif
+            ok &= (evt.param1 < numThreads);
+            if (evt.param1 < numThreads)
+                sequences[evt.param1].push_back(evt.param2);
+        }
+        return ok;
+    }
+
+    static bool isRun(const std::vector<ureg>& sequence, ureg first, ureg count) {
+        if (sequence.size() != count)
+            return false;
+        for (ureg i = 0; i < count; i++) {
+            if (sequence[i] != first + i)
+                return false;
+        }
+        return true;
+    }
+
+    void configure(ureg maxPagesPerThread, ureg maxPages, turf::Trace_MemLog::Policy policy) {
+        turf::Trace_MemLog::Params params;
+        params.eventsPerPage = EventsPerPage;
+        params.maxPagesPerThread = maxPagesPerThread;
+        params.maxPages = maxPages;
+        params.policy = policy;
+        m_log.configure(params);
+    }
+
+public:
+    MemLogTester() : m_numFinished(0), m_batchSize(0) {
+    }
+
+    // A thread that reaches maxPagesPerThread keeps its newest pages under OverwriteOldest, and its oldest ones
+    // under StopWhenFull.
+    bool testPagesPerThread() {
+        bool ok = true;
+        std::vector<std::vector<ureg> > sequences;
+        configure(4, 16, turf::Trace_MemLog::OverwriteOldest);
+        runBatch(0, 1);
+        ok &= collect(1, sequences);
+        ok &= isRun(sequences[0], NumEvents - 4 * EventsPerPage, 4 * EventsPerPage);
+
+        configure(4, 16, turf::Trace_MemLog::StopWhenFull);
+        runBatch(0, 1);
+        ok &= collect(1, sequences);
+        ok &= isRun(sequences[0], 0, 4 * EventsPerPage);
+        return ok;
+    }
+
+    // Under StopWhenFull, once maxPages are in use, every thread keeps the start of its events and drops the rest.
+    bool testStopWhenFull() {
+        static const ureg NumThreads = 6;
+        bool ok = true;
+        configure(4, 10, turf::Trace_MemLog::StopWhenFull);
+        runBatch(0, NumThreads);
+        std::vector<std::vector<ureg> > sequences;
+        ok &= collect(NumThreads, sequences);
+        ureg numEvents = 0;
+        for (ureg t = 0; t < NumThreads; t++) {
+            ok &= isRun(sequences[t], 0, sequences[t].size());
+            numEvents += sequences[t].size();
+        }
+        ok &= (numEvents == 10 * EventsPerPage);
+        return ok;
+    }
+
+    // Logs from batches of threads that all exit before the next batch starts, so later threads only get pages by
+    // taking them from earlier ones. The most recent event of every thread in the last batch must survive. Earlier
+    // threads' events may be gone, since a new thread can be given the ID, and the log, of one that has exited.
+    bool testOverwriteOldest() {
+        static const ureg NumBatches = 3;
+        static const ureg BatchSize = 12;
+        bool ok = true;
+        configure(4, 16, turf::Trace_MemLog::OverwriteOldest);
+        for (ureg b = 0; b < NumBatches; b++)
+            runBatch(b * BatchSize, BatchSize);
+        std::vector<std::vector<ureg> > sequences;
+        ok &= collect(NumBatches * BatchSize, sequences);
+        ureg numEvents = 0;
+        for (ureg t = 0; t < NumBatches * BatchSize; t++) {
+            numEvents += sequences[t].size();
+            if (t >= (NumBatches - 1) * BatchSize)
+                ok &= (!sequences[t].empty() && sequences[t].back() == NumEvents - 1);
+        }
+        ok &= (numEvents <= 16 * EventsPerPage);
+        return ok;
+    }
+
+    // Dumps whatever the last test logged, reads it back the way MemLogDecoder does, and compares it with the log.
+    bool testBinaryDump() {
+        static const char* path = "MemLogTester.bin";
+        if (!m_log.dumpEntireLogBinary(path))
+            return false;
+        LogFile file;
+        bool ok = false;
+        if (FILE* f = fopen(path, "rb")) {
+            ok = file.read(f);
+            fclose(f);
+        }
+        remove(path);
+        ureg r = 0;
+        for (turf::Trace_MemLog::Iterator iter = m_log.begin(); ok && iter != m_log.end(); ++iter, ++r) {
+            const turf::Trace_MemLog::Event& evt = *iter;
+            if (r >= file.records.size())
+                return false;
+            const FileRecord& record = file.records[r];
+            ok &= (record.tid == (u64) evt.tid && record.param1 == evt.param1 && record.param2 == evt.param2);
+            ok &= (strcmp(file.strings[record.msgIndex], evt.msg) == 0);
+            ok &= (r == 0 || record.time >= file.records[r - 1].time);
+        }
+        ok &= (r == file.records.size());
+        ok &= (file.header.numStrings == 1);
+        return ok;
+    }
+
+    // Dumps whatever the last test logged as text, and checks that there's one line per event. With timestamps, the
+    // times must start at zero, never go backwards, and agree with the time since the previous event.
+    bool testTextDump() {
+        static const char* path = "MemLogTester.txt";
+        if (!m_log.dumpEntireLog(path))
+            return false;
+        bool ok = false;
+        ureg numLines = 0;
+        if (FILE* f = fopen(path, "r")) {
+            ok = true;
+            char line[256];
+#if TURF_TRACE_MEMLOG_TIMESTAMPS
+            double prev = 0;
+#endif
+            while (fgets(line, sizeof(line), f)) {
+#if TURF_TRACE_MEMLOG_TIMESTAMPS
+                double time = 0;
+                double delta = 0;
+                ok &= (sscanf(line, "%lf %lf", &time, &delta) == 2);
+                ok &= (numLines > 0 || time == 0) && time >= prev;
+                // Both columns are rounded to three decimals.
+                ok &= (time - prev - delta < 0.002 && delta - (time - prev) < 0.002);
+                prev = time;
+#endif
+                numLines++;
+            }
+            fclose(f);
+        }
+        remove(path);
+        ureg numEvents = 0;
+        turf::Trace_MemLog::Iterator half;
+        for (turf::Trace_MemLog::Iterator iter = m_log.begin(); iter != m_log.end(); ++iter) {
+            if (numEvents++ == numLines / 2)
+                half = iter;
+        }
+        ok &= (numLines == numEvents && numEvents > 0);
+        // A copy of an iterator carries on from the same event on its own.
+        for (ureg i = numLines / 2; i < numLines; i++, ++half)
+            ok &= (half != m_log.end());
+        ok &= !(half != m_log.end());
+        return ok;
+    }
+};
+
+bool testMemLog() {
+    MemLogTester tester;
+    bool ok = tester.testPagesPerThread();
+    ok &= tester.testStopWhenFull();
+    ok &= tester.testOverwriteOldest();
+    ok &= tester.testBinaryDump();
+    ok &= tester.testTextDump();
+    return ok;
+}
@@ -0,0 +1,122 @@
+/*------------------------------------------------------------------------
+  Turf: Configurable C++ platform adapter
+  Copyright (c) 2016 Jeff Preshing
+
+  Distributed under the Simplified BSD License.
+  Original location: https://github.com/preshing/turf
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the LICENSE file for more information.
+------------------------------------------------------------------------*/
+
+#include <turf/MemPage.h>
+#include <stdio.h>
+using namespace turf::intTypes;
+
+//---------------------------------------------------------
+// MemPageTester
+// Allocates sizes that aren't multiples of the page size with each combination of flags, and checks
+// that freeing them gives all the address space back.
+//---------------------------------------------------------
+// Returns 0 where the address space size isn't available.
+static ureg getAddressSpaceSize() {
+#if TURF_KERNEL_LINUX
+    ureg result = 0;
+    FILE* f = fopen("/proc/self/status", "r");
+    if (f) {
+        char line[128];
+        unsigned long kb;
+        while (fgets(line, sizeof(line), f)) {
+            if (sscanf(line, "VmSize: %lu kB", &kb) == 1) {
+                result = (ureg) kb * 1024;
+                break;
+            }
+        }
+        fclose(f);
+    }
+    return result;
+#else
+    return 0;
+#endif
+}
+
+bool testMemPageFlags() {
+    static const u32 flagSets[] = {0, turf::MemPage::LargePages, turf::MemPage::Populate,
+                                   turf::MemPage::LargePages | turf::MemPage::Populate};
+    ureg largePageSize = turf::MemPage::getLargePageSize();
+    if (largePageSize == 0)
+        largePageSize = 2 * 1024 * 1024;
+    ureg sizes[] = {1, 4097, largePageSize - 1, largePageSize + 100, 3 * largePageSize + 4097};
+    bool ok = true;
+    for (ureg f = 0; f < sizeof(flagSets) / sizeof(flagSets[0]); f++) {
+        for (s32 numaNode = -1; numaNode <= 0; numaNode++) {
+            for (ureg s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+                ureg before = getAddressSpaceSize();
+                for (ureg i = 0; i < 20; i++) {
+                    void* mem;
+                    if (!turf::MemPage::alloc(mem, sizes[s], flagSets[f], numaNode)) {
+                        ok = false;
+                        continue;
+                    }
+                    u8* bytes = (u8*) mem;
+                    bytes[0] = 1;
+                    bytes[sizes[s] - 1] = 1;
+                    ok &= turf::MemPage::free(mem, sizes[s]);
+                }
+                // Twenty leaked tails would be several megabytes.
+                ureg after = getAddressSpaceSize();
+                ok &= (after <= before + 1024 * 1024);
+            }
+        }
+    }
+    // Requests no system can satisfy must fail, not hand back a bad pointer.
+    void* mem;
+    ureg hugeSize = ~ureg(0) - 1024 * 1024 * 1024 + 1;
+    ok &= !turf::MemPage::alloc(mem, hugeSize);
+    ok &= !turf::MemPage::alloc(mem, hugeSize, 0, -1);
+    return ok;
+}
+
+// Reserves a range, commits part of it, and checks that decommitted pages read back as zero once committed
+// again, that discarded pages stay usable, and that purged pages read back as zero.
+bool testMemPageReserve() {
+    ureg allocAlignment;
+    ureg pageSize = turf::MemPage::getPageSize(allocAlignment);
+    ureg numPages = 64;
+    ureg size = numPages * pageSize;
+    bool ok = true;
+    ureg before = getAddressSpaceSize();
+    for (ureg i = 0; i < 20; i++) {
+        void* mem;
+        if (!turf::MemPage::reserve(mem, size))
+            return false;
+        u8* bytes = (u8*) mem;
+        // Commit the middle half and write every page.
+        u8* middle = bytes + (numPages / 4) * pageSize;
+        ureg middleSize = (numPages / 2) * pageSize;
+        ok &= turf::MemPage::commit(middle, middleSize);
+        for (ureg offset = 0; offset < middleSize; offset += pageSize) {
+            ok &= (middle[offset] == 0);
+            middle[offset] = 0xab;
+        }
+        // Decommit and recommit one page. It must come back zeroed, and its neighbours must keep their contents.
+        u8* page = middle + pageSize;
+        ok &= turf::MemPage::decommit(page, pageSize);
+        ok &= turf::MemPage::commit(page, pageSize);
+        ok &= (page[0] == 0);
+        ok &= (page[-(sreg) pageSize] == 0xab);
+        ok &= (page[pageSize] == 0xab);
+        // A discarded page's contents are undefined, but it stays committed.
+        ok &= turf::MemPage::discard(page, pageSize);
+        page[0] = 0xcd;
+        ok &= (page[0] == 0xcd);
+        // A purged page reads as zero, without being committed again.
+        ok &= turf::MemPage::purge(page, pageSize);
+        ok &= (page[0] == 0);
+        ok &= (page[pageSize] == 0xab);
+        ok &= turf::MemPage::release(mem, size);
+    }
+    ok &= (getAddressSpaceSize() <= before + 1024 * 1024);
+    return ok;
+}
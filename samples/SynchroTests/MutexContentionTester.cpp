@@ -0,0 +1,118 @@
+/*------------------------------------------------------------------------
+  Turf: Configurable C++ platform adapter
+  Copyright (c) 2016 Jeff Preshing
+
+  Distributed under the Simplified BSD License.
+  Original location: https://github.com/preshing/turf
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the LICENSE file for more information.
+------------------------------------------------------------------------*/
+
+#include <vector>
+#include <thread>
+#include <stdio.h>
+#include <turf/Mutex.h>
+#include <turf/impl/Mutex_SpinLock.h>
+#include <turf/impl/Mutex_Ticket.h>
+#include <turf/impl/Mutex_MCS.h>
+#if TURF_KERNEL_LINUX
+#include <turf/impl/Mutex_Futex.h>
+#endif
+#include <turf/Atomic.h>
+#include <turf/Affinity.h>
+#include <turf/CPUTimer.h>
+#include <turf/Thread.h>
+#include <turf/Util.h>
+using namespace turf::intTypes;
+
+// Mutex_SpinLock has no constructor, since it's meant to be zero-initialized at global scope.
+// As a member, it has to be initialized explicitly.
+template <class LockType>
+static void initializeLock(LockType&) {
+}
+
+static void initializeLock(turf::Mutex_SpinLock& lock) {
+    lock.initialize();
+}
+
+//---------------------------------------------------------
+// MutexContentionTester
+// Hammers a single lock from many threads for a fixed amount of time, then reports
+// throughput and how evenly acquisitions were spread across threads.
+//---------------------------------------------------------
+template <class LockType>
+class MutexContentionTester {
+private:
+    LockType m_mutex;
+    ureg m_value;
+    turf::Atomic<u32> m_stop;
+    std::vector<ureg> m_acquisitions;
+
+public:
+    MutexContentionTester() : m_value(0), m_stop(0) {
+        initializeLock(m_mutex);
+    }
+
+    void threadFunc(ureg threadNum) {
+        ureg acquisitions = 0;
+        while (m_stop.load(turf::Relaxed) == 0) {
+            m_mutex.lock();
+            m_value++;
+            m_mutex.unlock();
+            acquisitions++;
+        }
+        m_acquisitions[threadNum] = acquisitions;
+    }
+
+    bool test(const char* name, ureg threadCount, ureg millis) {
+        m_value = 0;
+        m_stop.storeNonatomic(0);
+        m_acquisitions.resize(threadCount);
+
+        turf::CPUTimer::Point start = turf::CPUTimer::get();
+        std::vector<std::thread> threads;
+        for (ureg i = 0; i < threadCount; i++)
+            threads.emplace_back(&MutexContentionTester::threadFunc, this, i);
+        turf::Thread::sleepMillis(millis);
+        m_stop.store(1, turf::Relaxed);
+        for (std::thread& t : threads)
+            t.join();
+        turf::CPUTimer::Point end = turf::CPUTimer::get();
+
+        ureg total = 0;
+        ureg minAcquisitions = m_acquisitions[0];
+        ureg maxAcquisitions = m_acquisitions[0];
+        for (ureg i = 0; i < threadCount; i++) {
+            total += m_acquisitions[i];
+            minAcquisitions = turf::util::min(minAcquisitions, m_acquisitions[i]);
+            maxAcquisitions = turf::util::max(maxAcquisitions, m_acquisitions[i]);
+        }
+        float seconds = turf::CPUTimer::Converter().toSeconds(end - start);
+        printf("\n    %-16s %2d threads: %10.0f locks/s, per-thread min/max %" TURF_UREGD "/%" TURF_UREGD, name,
+               (int) threadCount, total / seconds, minAcquisitions, maxAcquisitions);
+        return m_value == total;
+    }
+};
+
+template <class LockType>
+bool runMutexContention(const char* name, ureg threadCount) {
+    MutexContentionTester<LockType> tester;
+    return tester.test(name, threadCount, 100);
+}
+
+bool testMutexContention() {
+    turf::Affinity affinity;
+    ureg threadCount = turf::util::max<ureg>(4, affinity.getNumHWThreads());
+    bool success = true;
+    success &= runMutexContention<turf::Mutex>("Mutex", threadCount);
+    success &= runMutexContention<turf::Mutex_SpinLock>("Mutex_SpinLock", threadCount);
+    success &= runMutexContention<turf::Mutex_Ticket>("Mutex_Ticket", threadCount);
+    success &= runMutexContention<turf::Mutex_MCS>("Mutex_MCS", threadCount);
+#if TURF_KERNEL_LINUX
+    success &= runMutexContention<turf::Mutex_Futex>("Mutex_Futex", threadCount);
+#endif
+    printf("\n   ");
+    return success;
+}
@@ -13,19 +13,37 @@
 #include <vector>
 #include <thread>
 #include <turf/Mutex.h>
+#include <turf/impl/Mutex_SpinLock.h>
+#include <turf/impl/Mutex_Ticket.h>
+#include <turf/impl/Mutex_MCS.h>
+#if TURF_KERNEL_LINUX
+#include <turf/impl/Mutex_Futex.h>
+#endif
 using namespace turf::intTypes;
 
+// Mutex_SpinLock has no constructor, since it's meant to be zero-initialized at global scope.
+// As a member, it has to be initialized explicitly.
+template <class LockType>
+static void initializeLock(LockType&) {
+}
+
+static void initializeLock(turf::Mutex_SpinLock& lock) {
+    lock.initialize();
+}
+
 //---------------------------------------------------------
 // MutexTester
 //---------------------------------------------------------
+template <class LockType>
 class MutexTester {
 private:
     int m_iterationCount;
-    turf::Mutex m_mutex;
+    LockType m_mutex;
     int m_value;
 
 public:
     MutexTester() : m_iterationCount(0), m_value(0) {
+        initializeLock(m_mutex);
     }
 
     void threadFunc(int threadNum) {
@@ -51,6 +69,30 @@ public:
 };
 
 bool testMutex() {
-    MutexTester tester;
+    MutexTester<turf::Mutex> tester;
+    return tester.test(4, 400000);
+}
+
+bool testMutexSpinLock() {
+    MutexTester<turf::Mutex_SpinLock> tester;
+    return tester.test(4, 400000);
+}
+
+// Fair locks hand off to waiters that may not be running when threads outnumber cores,
+// so they get fewer iterations here.
+bool testMutexTicket() {
+    MutexTester<turf::Mutex_Ticket> tester;
+    return tester.test(4, 40000);
+}
+
+bool testMutexMCS() {
+    MutexTester<turf::Mutex_MCS> tester;
+    return tester.test(4, 40000);
+}
+
+#if TURF_KERNEL_LINUX
+bool testMutexFutex() {
+    MutexTester<turf::Mutex_Futex> tester;
     return tester.test(4, 400000);
 }
+#endif
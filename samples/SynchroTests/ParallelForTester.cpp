@@ -0,0 +1,90 @@
+/*------------------------------------------------------------------------
+  Turf: Configurable C++ platform adapter
+  Copyright (c) 2016 Jeff Preshing
+
+  Distributed under the Simplified BSD License.
+  Original location: https://github.com/preshing/turf
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the LICENSE file for more information.
+------------------------------------------------------------------------*/
+
+#include <turf/extra/ParallelFor.h>
+#include <vector>
+using namespace turf::intTypes;
+
+//---------------------------------------------------------
+// ParallelForTester
+// Iteration i costs about i units of work, so a static split would leave the threads unbalanced.
+// Checks that every index is visited exactly once, and that the reduction matches a serial loop.
+//---------------------------------------------------------
+static u64 unevenWork(ureg index) {
+    u64 x = index;
+    for (ureg i = 0; i < index; i++)
+        x = x * 6364136223846793005ull + 1442695040888963407ull;
+    return x;
+}
+
+struct VisitFn {
+    std::vector<u32>& visits;
+    std::vector<u64>& results;
+
+    VisitFn(std::vector<u32>& visits, std::vector<u64>& results) : visits(visits), results(results) {
+    }
+
+    void operator()(ureg begin, ureg end) const {
+        for (ureg i = begin; i < end; i++) {
+            visits[i]++;
+            results[i] = unevenWork(i);
+        }
+    }
+};
+
+struct SumFn {
+    u64 operator()(ureg begin, ureg end) const {
+        u64 sum = 0;
+        for (ureg i = begin; i < end; i++)
+            sum += unevenWork(i);
+        return sum;
+    }
+};
+
+struct AddFn {
+    u64 operator()(u64 a, u64 b) const {
+        return a + b;
+    }
+};
+
+bool testParallelFor() {
+    turf::extra::JobDispatcher dispatcher(4);
+    static const ureg Size = 3000;
+    static const ureg grains[] = {0, 1, 7, 64, Size, Size * 2};
+    bool ok = true;
+    u64 expectedSum = 0;
+    for (ureg i = 0; i < Size; i++)
+        expectedSum += unevenWork(i);
+
+    for (ureg g = 0; g < sizeof(grains) / sizeof(grains[0]); g++) {
+        ureg begin = g * 11; // Ranges needn't start at zero
+        std::vector<u32> visits(Size, 0);
+        std::vector<u64> results(Size, 0);
+        turf::extra::parallelFor(dispatcher, begin, Size, grains[g], VisitFn(visits, results));
+        for (ureg i = 0; i < Size; i++) {
+            ok &= (visits[i] == (i >= begin ? 1u : 0u));
+            if (i >= begin)
+                ok &= (results[i] == unevenWork(i));
+        }
+
+        u64 sum = turf::extra::parallelReduce(dispatcher, 0, Size, grains[g], u64(0), SumFn(), AddFn());
+        ok &= (sum == expectedSum);
+    }
+
+    // Empty range
+    std::vector<u32> visits(1, 0);
+    std::vector<u64> results(1, 0);
+    turf::extra::parallelFor(dispatcher, 5, 5, 0, VisitFn(visits, results));
+    ok &= (visits[0] == 0);
+    ok &= (turf::extra::parallelReduce(dispatcher, 5, 5, 0, u64(42), SumFn(), AddFn()) == 42);
+    return ok;
+}
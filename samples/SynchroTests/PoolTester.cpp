@@ -0,0 +1,103 @@
+/*------------------------------------------------------------------------
+  Turf: Configurable C++ platform adapter
+  Copyright (c) 2016 Jeff Preshing
+
+  Distributed under the Simplified BSD License.
+  Original location: https://github.com/preshing/turf
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the LICENSE file for more information.
+------------------------------------------------------------------------*/
+
+#include <vector>
+#include <thread>
+#include <random>
+#include <turf/Pool.h>
+#include <turf/Atomic.h>
+using namespace turf::intTypes;
+
+//---------------------------------------------------------
+// PoolTester
+// Threads allocate blocks, stamp them with a unique value, and free them, often after passing them
+// to another thread through a shared array. If a block is ever handed out twice, one of its
+// owners finds a different stamp when it frees the block, and the test fails.
+//---------------------------------------------------------
+class PoolTester {
+private:
+    struct Node {
+        u64 stamp;
+        u64 check;
+        TURF_USE_POOL(Node)
+    };
+
+    static const ureg NumShared = 256;
+    static const ureg NumLocal = 64;
+    turf::Atomic<Node*> m_shared[NumShared];
+    int m_iterationCount;
+    turf::Atomic<sreg> m_success;
+
+    bool release(Node* node) {
+        if (!node)
+            return true;
+        bool ok = node->check == ~node->stamp;
+        delete node;
+        return ok;
+    }
+
+public:
+    PoolTester() : m_iterationCount(0), m_success(0) {
+    }
+
+    void threadFunc(int threadNum) {
+        std::mt19937 randomEngine(threadNum);
+        Node* local[NumLocal] = {};
+        u64 stamp = u64(threadNum) << 40;
+        bool ok = true;
+
+        for (int i = 0; i < m_iterationCount; i++) {
+            ureg index = randomEngine() % NumLocal;
+            if (!local[index]) {
+                Node* node = new Node;
+                node->stamp = ++stamp;
+                node->check = ~stamp;
+                local[index] = node;
+            } else if (randomEngine() % 2 == 0) {
+                ok &= release(local[index]);
+                local[index] = NULL;
+            } else {
+                // Trade it for a node from the shared array, which another thread probably allocated.
+                Node* other = m_shared[randomEngine() % NumShared].exchange(local[index], turf::ConsumeRelease);
+                local[index] = other;
+            }
+        }
+        for (ureg i = 0; i < NumLocal; i++)
+            ok &= release(local[i]);
+        turf::Pool<Node>::instance().flushThreadCache();
+        if (!ok)
+            m_success.store(0, turf::Relaxed);
+    }
+
+    bool test(int threadCount, int iterationCount) {
+        m_iterationCount = iterationCount;
+        for (ureg i = 0; i < NumShared; i++)
+            m_shared[i].storeNonatomic(NULL);
+        m_success.storeNonatomic(1);
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < threadCount; i++)
+            threads.emplace_back(&PoolTester::threadFunc, this, i);
+        for (std::thread& t : threads)
+            t.join();
+
+        bool ok = m_success.loadNonatomic() != 0;
+        for (ureg i = 0; i < NumShared; i++)
+            ok &= release(m_shared[i].loadNonatomic());
+        return ok;
+    }
+};
+
+bool testPool() {
+    PoolTester tester;
+    return tester.test(4, 1000000);
+}
@@ -16,22 +16,35 @@
 #include <thread>
 #include <random>
 #include <turf/RWLock.h>
+#include <turf/impl/RWLock_Distributed.h>
 #include <turf/Atomic.h>
+#include <turf/Affinity.h>
+#include <turf/CPUTimer.h>
+#include <turf/Thread.h>
+#include <turf/Util.h>
+#include <turf/extra/Random.h>
+#include <stdio.h>
 using namespace turf::intTypes;
 
 //---------------------------------------------------------
 // RWLockTester
 //---------------------------------------------------------
+template <class LockType>
 class RWLockTester {
 private:
     static const int SharedArraySize = 8;
     int m_shared[SharedArraySize];
-    turf::RWLock m_rwLock;
+    LockType m_rwLock;
     int m_iterationCount;
     turf::Atomic<sreg> m_success;
+    // Throughput mode
+    int m_writeOneIn;
+    turf::Atomic<u32> m_stop;
+    turf::Atomic<ureg> m_totalReads;
+    turf::Atomic<ureg> m_totalWrites;
 
 public:
-    RWLockTester() : m_iterationCount(0), m_success(0) {
+    RWLockTester() : m_iterationCount(0), m_success(0), m_writeOneIn(0), m_stop(0), m_totalReads(0), m_totalWrites(0) {
     }
 
     void threadFunc(int threadNum) {
@@ -43,7 +56,7 @@ public:
             if (std::uniform_int_distribution<>(0, 3)(randomEngine) == 0) {
                 // Write an incrementing sequence of numbers (backwards).
                 int value = std::uniform_int_distribution<>()(randomEngine);
-                turf::ExclusiveLockGuard<turf::RWLock> guard(m_rwLock);
+                turf::ExclusiveLockGuard<LockType> guard(m_rwLock);
                 for (int j = SharedArraySize - 1; j >= 0; j--) {
                     m_shared[j] = value--;
                 }
@@ -51,7 +64,7 @@ public:
                 // Check that the sequence of numbers is incrementing.
                 bool ok = true;
                 {
-                    turf::SharedLockGuard<turf::RWLock> guard(m_rwLock);
+                    turf::SharedLockGuard<LockType> guard(m_rwLock);
                     int value = m_shared[0];
                     for (int j = 1; j < SharedArraySize; j++) {
                         ok = ok && (++value == m_shared[j]);
@@ -79,9 +92,84 @@ public:
 
         return m_success.loadNonatomic() != 0;
     }
+
+    // Throughput mode: Runs for a fixed amount of time, doing one write in every
+    // writeOneIn operations, and reports the number of operations completed.
+    void throughputThreadFunc(int threadNum) {
+        turf::extra::Random random;
+        ureg reads = 0;
+        ureg writes = 0;
+        while (m_stop.load(turf::Relaxed) == 0) {
+            if (random.next32() % m_writeOneIn == 0) {
+                turf::ExclusiveLockGuard<LockType> guard(m_rwLock);
+                int value = m_shared[0] + 1;
+                for (int j = 0; j < SharedArraySize; j++)
+                    m_shared[j] = value++;
+                writes++;
+            } else {
+                turf::SharedLockGuard<LockType> guard(m_rwLock);
+                int value = m_shared[0];
+                for (int j = 1; j < SharedArraySize; j++) {
+                    if (++value != m_shared[j])
+                        m_success.store(0, turf::Relaxed);
+                }
+                reads++;
+            }
+        }
+        m_totalReads.fetchAdd(reads, turf::Relaxed);
+        m_totalWrites.fetchAdd(writes, turf::Relaxed);
+    }
+
+    bool measureThroughput(const char* name, int threadCount, int writeOneIn, ureg millis) {
+        m_writeOneIn = writeOneIn;
+        for (int j = 0; j < SharedArraySize; j++)
+            m_shared[j] = j;
+        m_success.storeNonatomic(1);
+        m_stop.storeNonatomic(0);
+        m_totalReads.storeNonatomic(0);
+        m_totalWrites.storeNonatomic(0);
+
+        turf::CPUTimer::Point start = turf::CPUTimer::get();
+        std::vector<std::thread> threads;
+        for (int i = 0; i < threadCount; i++)
+            threads.emplace_back(&RWLockTester::throughputThreadFunc, this, i);
+        turf::Thread::sleepMillis(millis);
+        m_stop.store(1, turf::Relaxed);
+        for (std::thread& t : threads)
+            t.join();
+        turf::CPUTimer::Point end = turf::CPUTimer::get();
+
+        float seconds = turf::CPUTimer::Converter().toSeconds(end - start);
+        printf("\n    %-20s %2d threads, 1 write in %4d: %10.0f reads/s, %8.0f writes/s", name, threadCount, writeOneIn,
+               m_totalReads.loadNonatomic() / seconds, m_totalWrites.loadNonatomic() / seconds);
+        return m_success.loadNonatomic() != 0;
+    }
 };
 
 bool testRWLock() {
-    RWLockTester tester;
+    RWLockTester<turf::RWLock> tester;
     return tester.test(4, 1000000);
 }
+
+bool testRWLockDistributed() {
+    RWLockTester<turf::RWLock_Distributed> tester;
+    return tester.test(4, 1000000);
+}
+
+bool testRWLockThroughput() {
+    turf::Affinity affinity;
+    int threadCount = (int) turf::util::max<ureg>(4, affinity.getNumHWThreads());
+    bool success = true;
+    for (int writeOneIn = 10; writeOneIn <= 1000; writeOneIn *= 10) {
+        {
+            RWLockTester<turf::RWLock> tester;
+            success &= tester.measureThroughput("RWLock", threadCount, writeOneIn, 100);
+        }
+        {
+            RWLockTester<turf::RWLock_Distributed> tester;
+            success &= tester.measureThroughput("RWLock_Distributed", threadCount, writeOneIn, 100);
+        }
+    }
+    printf("\n   ");
+    return success;
+}
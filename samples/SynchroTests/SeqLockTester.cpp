@@ -0,0 +1,110 @@
+/*------------------------------------------------------------------------
+  Turf: Configurable C++ platform adapter
+  Copyright (c) 2016 Jeff Preshing
+
+  Distributed under the Simplified BSD License.
+  Original location: https://github.com/preshing/turf
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the LICENSE file for more information.
+------------------------------------------------------------------------*/
+
+#include <vector>
+#include <thread>
+#include <random>
+#include <turf/SeqLock.h>
+#include <turf/Atomic.h>
+using namespace turf::intTypes;
+
+//---------------------------------------------------------
+// SeqLockTester
+// Same workload as RWLockTester: writers store an incrementing sequence of numbers,
+// readers check that every snapshot they accept is incrementing. A torn read that
+// slips past retryRead() fails the test.
+//---------------------------------------------------------
+class SeqLockTester {
+private:
+    static const int SharedArraySize = 8;
+    struct Snapshot {
+        int values[SharedArraySize];
+    };
+    int m_shared[SharedArraySize];
+    turf::SeqLock m_seqLock;
+    turf::SeqLockProtected<Snapshot> m_protected;
+    int m_iterationCount;
+    turf::Atomic<sreg> m_success;
+
+    static bool isIncrementing(const int* values) {
+        int value = values[0];
+        for (int j = 1; j < SharedArraySize; j++) {
+            if (++value != values[j])
+                return false;
+        }
+        return true;
+    }
+
+public:
+    SeqLockTester() : m_iterationCount(0), m_success(0) {
+    }
+
+    void threadFunc(int threadNum) {
+        std::random_device rd;
+        std::mt19937 randomEngine(rd());
+
+        for (int i = 0; i < m_iterationCount; i++) {
+            // Choose randomly whether to read or write.
+            if (std::uniform_int_distribution<>(0, 3)(randomEngine) == 0) {
+                // Write an incrementing sequence of numbers (backwards), once through
+                // the raw SeqLock and once through SeqLockProtected.
+                int value = std::uniform_int_distribution<>()(randomEngine);
+                Snapshot snapshot;
+                m_seqLock.beginWrite();
+                for (int j = SharedArraySize - 1; j >= 0; j--) {
+                    m_shared[j] = value;
+                    snapshot.values[j] = value--;
+                }
+                m_seqLock.endWrite();
+                m_protected.store(snapshot);
+            } else {
+                // Copy the shared array under the SeqLock, then check the copy.
+                int copy[SharedArraySize];
+                u32 seq;
+                do {
+                    seq = m_seqLock.beginRead();
+                    for (int j = 0; j < SharedArraySize; j++) {
+                        copy[j] = m_shared[j];
+                    }
+                } while (m_seqLock.retryRead(seq));
+                Snapshot snapshot = m_protected.load();
+                if (!isIncrementing(copy) || !isIncrementing(snapshot.values)) {
+                    m_success.store(0, turf::Relaxed);
+                }
+            }
+        }
+    }
+
+    bool test(int threadCount, int iterationCount) {
+        m_iterationCount = iterationCount;
+        Snapshot snapshot;
+        for (int j = 0; j < SharedArraySize; j++) {
+            m_shared[j] = j;
+            snapshot.values[j] = j;
+        }
+        m_protected.store(snapshot);
+        m_success.storeNonatomic(1);
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < threadCount; i++)
+            threads.emplace_back(&SeqLockTester::threadFunc, this, i);
+        for (std::thread& t : threads)
+            t.join();
+
+        return m_success.loadNonatomic() != 0;
+    }
+};
+
+bool testSeqLock() {
+    SeqLockTester tester;
+    return tester.test(4, 1000000);
+}
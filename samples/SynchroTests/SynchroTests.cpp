@@ -22,17 +22,61 @@ struct TestInfo {
 };
 
 bool testMutex();
+bool testMutexSpinLock();
+bool testMutexTicket();
+bool testMutexMCS();
+#if TURF_KERNEL_LINUX
+bool testMutexFutex();
+#endif
+bool testMutexContention();
 bool testRecursiveMutex();
 bool testRWLock();
+bool testRWLockDistributed();
+bool testRWLockThroughput();
 bool testRWLockSimple();
+bool testSeqLock();
+bool testPool();
+bool testArena();
+bool testHeap();
+bool testMemPageFlags();
+bool testMemPageReserve();
+bool testMemLog();
+bool testCounters();
+bool testAffinity();
+bool testJobDispatcher();
+bool testTaskScheduler();
+bool testParallelFor();
 
 // clang-format off
 #define ADD_TEST(name) {#name, name},
 TestInfo g_tests[] = {
     ADD_TEST(testMutex)
+    ADD_TEST(testMutexSpinLock)
+    ADD_TEST(testMutexTicket)
+    ADD_TEST(testMutexMCS)
+#if TURF_KERNEL_LINUX
+    ADD_TEST(testMutexFutex)
+#endif
+    ADD_TEST(testMutexContention)
+#if !TURF_USE_FUTEX // Mutex_Futex is not recursive
     ADD_TEST(testRecursiveMutex)
+#endif
     ADD_TEST(testRWLock)
+    ADD_TEST(testRWLockDistributed)
+    ADD_TEST(testRWLockThroughput)
     ADD_TEST(testRWLockSimple) 
+    ADD_TEST(testSeqLock)
+    ADD_TEST(testPool)
+    ADD_TEST(testArena)
+    ADD_TEST(testHeap)
+    ADD_TEST(testMemPageFlags)
+    ADD_TEST(testMemPageReserve)
+    ADD_TEST(testMemLog)
+    ADD_TEST(testCounters)
+    ADD_TEST(testAffinity)
+    ADD_TEST(testJobDispatcher)
+    ADD_TEST(testTaskScheduler)
+    ADD_TEST(testParallelFor)
 };
 // clang-format on
 
@@ -0,0 +1,98 @@
+/*------------------------------------------------------------------------
+  Turf: Configurable C++ platform adapter
+  Copyright (c) 2016 Jeff Preshing
+
+  Distributed under the Simplified BSD License.
+  Original location: https://github.com/preshing/turf
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the LICENSE file for more information.
+------------------------------------------------------------------------*/
+
+#include <turf/extra/TaskScheduler.h>
+using namespace turf::intTypes;
+
+//---------------------------------------------------------
+// TaskSchedulerTester
+// Computes Fibonacci numbers the naive way, which spawns a deep, irregular tree of tiny tasks.
+// FibTask waits for its children with sync(). FibContinuationTask returns right away and adds up
+// its children's results in onComplete().
+//---------------------------------------------------------
+class FibTask : public turf::extra::Task {
+private:
+    u32 m_n;
+    u64* m_result;
+
+public:
+    FibTask(u32 n, u64* result) : m_n(n), m_result(result) {
+    }
+
+    virtual void execute() {
+        if (m_n < 2) {
+            *m_result = m_n;
+            return;
+        }
+        u64 a, b;
+        FibTask childA(m_n - 1, &a);
+        FibTask childB(m_n - 2, &b);
+        spawn(childA);
+        spawn(childB);
+        sync();
+        *m_result = a + b;
+    }
+};
+
+class FibContinuationTask : public turf::extra::Task {
+private:
+    u32 m_n;
+    u64* m_result;
+    u64 m_a;
+    u64 m_b;
+    FibContinuationTask* m_childA;
+    FibContinuationTask* m_childB;
+
+public:
+    FibContinuationTask(u32 n, u64* result) : m_n(n), m_result(result), m_childA(NULL), m_childB(NULL) {
+    }
+
+    virtual void execute() {
+        if (m_n < 2) {
+            *m_result = m_n;
+            return;
+        }
+        m_childA = new FibContinuationTask(m_n - 1, &m_a);
+        m_childB = new FibContinuationTask(m_n - 2, &m_b);
+        spawn(*m_childA);
+        spawn(*m_childB);
+    }
+
+    virtual void onComplete() {
+        if (m_childA) {
+            *m_result = m_a + m_b;
+            delete m_childA;
+            delete m_childB;
+        }
+    }
+};
+
+static u64 fib(u32 n) {
+    return n < 2 ? n : fib(n - 1) + fib(n - 2);
+}
+
+bool testTaskScheduler() {
+    turf::extra::JobDispatcher dispatcher(4);
+    turf::extra::TaskScheduler scheduler(dispatcher);
+    bool ok = true;
+    for (u32 n = 0; n < 24; n += 3) {
+        u64 result = 0;
+        FibTask task(n, &result);
+        scheduler.run(task);
+        ok &= (result == fib(n));
+        u64 result2 = 0;
+        FibContinuationTask task2(n, &result2);
+        scheduler.run(task2);
+        ok &= (result2 == fib(n));
+    }
+    return ok;
+}
@@ -0,0 +1,105 @@
+/*------------------------------------------------------------------------
+  Turf: Configurable C++ platform adapter
+  Copyright (c) 2016 Jeff Preshing
+
+  Distributed under the Simplified BSD License.
+  Original location: https://github.com/preshing/turf
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the LICENSE file for more information.
+------------------------------------------------------------------------*/
+
+#ifndef TURF_ADAPTIVEBACKOFF_H
+#define TURF_ADAPTIVEBACKOFF_H
+
+#include <turf/Core.h>
+#include <turf/Atomic.h>
+#include <turf/Thread.h>
+#if TURF_KERNEL_LINUX
+#include <turf/impl/Futex_Linux.h>
+#endif
+
+namespace turf {
+
+//---------------------------------------------------------
+// AdaptiveBackoff
+// Call wait() once after each failed attempt in a spin loop.
+// The first rounds execute an exponentially growing number of pause instructions,
+// the next rounds yield the thread to the OS, and after that the thread either
+// keeps yielding, or, using the wait(word, expected) overload, parks on a futex.
+// Construct a new AdaptiveBackoff (or call reset()) for each acquisition.
+//---------------------------------------------------------
+class AdaptiveBackoff {
+public:
+    struct Params {
+        u32 spinRounds;  // Rounds of pause instructions; round N executes 2^N pauses.
+        u32 yieldRounds; // Rounds of yielding the thread before parking is allowed.
+        u32 parkMillis;  // Upper bound on each park, so it's safe even if nobody calls wakeAll().
+
+        Params(u32 spinRounds = 7, u32 yieldRounds = 16, u32 parkMillis = 1)
+            : spinRounds(spinRounds), yieldRounds(yieldRounds), parkMillis(parkMillis) {
+        }
+    };
+
+private:
+    Params m_params;
+    u32 m_round;
+
+public:
+    AdaptiveBackoff(const Params& params = Params()) : m_params(params), m_round(0) {
+    }
+
+    void reset() {
+        m_round = 0;
+    }
+
+    bool isSpinning() const {
+        return m_round < m_params.spinRounds;
+    }
+
+    // True once the spin and yield rounds are used up, which is when a waiting thread should consider parking.
+    bool isExhausted() const {
+        return m_round >= m_params.spinRounds + m_params.yieldRounds;
+    }
+
+    void wait() {
+        if (m_round < m_params.spinRounds) {
+            for (u32 i = (1u << m_round); i > 0; i--)
+                turf_yieldHWThread();
+            m_round++;
+        } else {
+            Thread::yield();
+            if (m_round < m_params.spinRounds + m_params.yieldRounds)
+                m_round++;
+        }
+    }
+
+    // Like wait(), but once the spin and yield rounds are used up, parks the thread
+    // for as long as word holds expected, up to parkMillis. Wake it early with wakeAll().
+    void wait(Atomic<u32>& word, u32 expected) {
+        if (!isExhausted()) {
+            wait();
+        } else {
+#if TURF_KERNEL_LINUX
+            Futex_Linux::timedWait(word, expected, m_params.parkMillis);
+#else
+            Thread::yield();
+#endif
+        }
+    }
+
+    // Wakes threads parked on word. Costs a syscall, so callers should only use it
+    // when they know someone may be parked.
+    static void wakeAll(Atomic<u32>& word) {
+#if TURF_KERNEL_LINUX
+        Futex_Linux::wakeAll(word);
+#else
+        TURF_UNUSED(word);
+#endif
+    }
+};
+
+} // namespace turf
+
+#endif // TURF_ADAPTIVEBACKOFF_H
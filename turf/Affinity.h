@@ -43,6 +43,11 @@
 // Include the implementation:
 #include TURF_IMPL_AFFINITY_PATH
 
+// Every implementation describes the cores the process may run on, numbered from zero, each with one or more
+// hardware threads. getNumaNode(core) returns the kernel's NUMA node number, or -1 if unknown, and
+// getCacheDomain(core) numbers the groups of cores sharing a last-level cache. Where nodes and caches can't be
+// detected (currently everywhere except Linux and Win32), there's one node, numbered -1, and one cache domain.
+
 // Alias it:
 namespace turf {
 typedef TURF_IMPL_AFFINITY_TYPE Affinity;
@@ -0,0 +1,126 @@
+/*------------------------------------------------------------------------
+  Turf: Configurable C++ platform adapter
+  Copyright (c) 2016 Jeff Preshing
+
+  Distributed under the Simplified BSD License.
+  Original location: https://github.com/preshing/turf
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the LICENSE file for more information.
+------------------------------------------------------------------------*/
+
+#include <turf/Core.h>
+#include <turf/Arena.h>
+#include <turf/MemPage.h>
+#include <turf/Assert.h>
+#include <string.h>
+
+namespace turf {
+
+Arena::Arena(ureg chunkSize) : m_chunks(NULL), m_pos(NULL), m_end(NULL), m_last(NULL) {
+    ureg allocAlignment;
+    ureg pageSize = MemPage::getPageSize(allocAlignment);
+    m_chunkSize = util::align(chunkSize, pageSize);
+}
+
+Arena::~Arena() {
+    freeChunksAfter(NULL);
+}
+
+void Arena::freeChunksAfter(Chunk* keep) {
+    while (m_chunks != keep) {
+        Chunk* chunk = m_chunks;
+        m_chunks = chunk->next;
+        MemPage::free(chunk, chunk->size);
+    }
+}
+
+void* Arena::allocSlow(ureg size, ureg alignment) {
+    ureg needed = sizeof(Chunk) + alignment + size;
+    ureg chunkSize = m_chunkSize;
+    if (needed > chunkSize) {
+        ureg allocAlignment;
+        chunkSize = util::align(needed, MemPage::getPageSize(allocAlignment));
+    }
+    void* mem;
+    if (!MemPage::alloc(mem, chunkSize))
+        return NULL;
+    if (m_chunks)
+        m_chunks->used = m_pos;
+    Chunk* chunk = (Chunk*) mem;
+    chunk->next = m_chunks;
+    chunk->size = chunkSize;
+    chunk->used = NULL;
+    m_chunks = chunk;
+    m_pos = (u8*) (chunk + 1);
+    m_end = (u8*) chunk + chunkSize;
+    return alloc(size, alignment);
+}
+
+void Arena::reset() {
+    if (!m_chunks)
+        return;
+    // Keep the oldest chunk, unless it was sized for a single large allocation.
+    Chunk* oldest = m_chunks;
+    while (oldest->next)
+        oldest = oldest->next;
+    if (oldest->size != m_chunkSize) {
+        freeChunksAfter(NULL);
+        m_pos = NULL;
+        m_end = NULL;
+    } else {
+        freeChunksAfter(oldest);
+        m_pos = (u8*) (oldest + 1);
+        m_end = (u8*) oldest + oldest->size;
+    }
+    m_last = NULL;
+}
+
+void Arena::rewind(const Marker& marker) {
+    if (!marker.chunk) {
+        reset();
+        return;
+    }
+    freeChunksAfter(marker.chunk);
+    m_pos = marker.pos;
+    m_end = (u8*) marker.chunk + marker.chunk->size;
+    m_last = NULL;
+}
+
+ureg Arena::getSystemBytes() const {
+    ureg total = 0;
+    for (Chunk* chunk = m_chunks; chunk; chunk = chunk->next)
+        total += chunk->size;
+    return total;
+}
+
+void* Arena::Operator::realloc(void* ptr, ureg newSize) {
+    if (!ptr)
+        return alloc(newSize);
+    Arena& arena = m_arena;
+    u8* bytes = (u8*) ptr;
+    if (bytes == arena.m_last && bytes + newSize <= arena.m_end) {
+        arena.m_pos = bytes + newSize;
+        return ptr;
+    }
+    // Only the most recent allocation's size is known. For anything else, copy everything up to the end of the
+    // allocated part of ptr's chunk.
+    ureg available = 0;
+    if (bytes == arena.m_last) {
+        available = arena.m_pos - bytes;
+    } else {
+        Chunk* chunk = arena.m_chunks;
+        while (chunk && !(bytes > (u8*) chunk && bytes <= (u8*) chunk + chunk->size))
+            chunk = chunk->next;
+        TURF_ASSERT(chunk); // ptr must belong to this arena
+        if (chunk)
+            available = (chunk == arena.m_chunks ? arena.m_pos : chunk->used) - bytes;
+    }
+    void* result = alloc(newSize);
+    if (result)
+        memcpy(result, ptr, util::min(available, newSize));
+    return result;
+}
+
+} // namespace turf
@@ -0,0 +1,141 @@
+/*------------------------------------------------------------------------
+  Turf: Configurable C++ platform adapter
+  Copyright (c) 2016 Jeff Preshing
+
+  Distributed under the Simplified BSD License.
+  Original location: https://github.com/preshing/turf
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the LICENSE file for more information.
+------------------------------------------------------------------------*/
+
+#ifndef TURF_ARENA_H
+#define TURF_ARENA_H
+
+#include <turf/Core.h>
+#include <turf/Util.h>
+
+namespace turf {
+
+//---------------------------------------------------------
+// Arena
+// A bump allocator for short-lived allocations that all die together.
+// Memory comes from chunks allocated with MemPage. Individual blocks are never freed;
+// instead, reset() releases everything at once, and rewind() releases everything allocated after a Marker.
+// Not thread-safe: use one Arena per thread or per task.
+//
+// Works with TURF_HEAP_DIRECT, so existing call sites can allocate from it:
+//
+//     turf::Arena arena;
+//     void* ptr = TURF_HEAP_DIRECT(arena).alloc(size);
+//---------------------------------------------------------
+class Arena {
+private:
+    static const ureg DefaultAlignment = 2 * sizeof(void*);
+
+    struct Chunk {
+        Chunk* next; // Previous chunk in allocation order
+        ureg size;   // Including this header
+        u8* used;    // End of the allocated part, once this is no longer the current chunk
+    };
+
+    ureg m_chunkSize;
+    Chunk* m_chunks; // Current chunk first
+    u8* m_pos;
+    u8* m_end;
+    u8* m_last; // Most recent allocation, which free() and realloc() can adjust in place
+
+    TURF_NO_INLINE void* allocSlow(ureg size, ureg alignment);
+    void freeChunksAfter(Chunk* keep);
+
+    // Not copyable
+    Arena(const Arena&);
+    Arena& operator=(const Arena&);
+
+public:
+    // chunkSize is rounded up to the page size. Larger allocations get a chunk of their own.
+    Arena(ureg chunkSize = 65536);
+    ~Arena();
+
+    void* alloc(ureg size, ureg alignment = DefaultAlignment) {
+        u8* ptr = (u8*) util::align((ureg) m_pos, alignment);
+        if (!m_pos || ptr + size > m_end)
+            return allocSlow(size, alignment);
+        m_pos = ptr + size;
+        m_last = ptr;
+        return ptr;
+    }
+
+    // Frees everything. The first chunk is kept for reuse.
+    void reset();
+
+    struct Marker {
+        Chunk* chunk;
+        u8* pos;
+    };
+
+    Marker getMarker() const {
+        Marker marker = {m_chunks, m_pos};
+        return marker;
+    }
+
+    // Frees everything allocated since the marker was taken.
+    void rewind(const Marker& marker);
+
+    // Rewinds the arena when it goes out of scope.
+    class Scope {
+    private:
+        Arena& m_arena;
+        Marker m_marker;
+
+    public:
+        Scope(Arena& arena) : m_arena(arena), m_marker(arena.getMarker()) {
+        }
+        ~Scope() {
+            m_arena.rewind(m_marker);
+        }
+    };
+
+    // Total size of all chunks, including any kept by reset().
+    ureg getSystemBytes() const;
+
+    class Operator {
+    private:
+        Arena& m_arena;
+
+    public:
+        Operator(Arena& arena) : m_arena(arena) {
+        }
+
+        void* alloc(ureg size) {
+            return m_arena.alloc(size);
+        }
+
+        void* allocAligned(ureg size, ureg alignment) {
+            return m_arena.alloc(size, alignment);
+        }
+
+        // Grows or shrinks the most recent allocation in place. Otherwise, allocates a new block and copies into it.
+        // Block sizes aren't recorded, so when ptr isn't the most recent allocation, the copy runs up to newSize bytes
+        // or the end of what's allocated in ptr's chunk, whichever comes first. That may include bytes past the old
+        // size, which the caller must treat as uninitialized, just as with any other realloc.
+        void* realloc(void* ptr, ureg newSize);
+
+        // Only the most recent allocation is actually released. Everything else waits for reset() or rewind().
+        void free(void* ptr) {
+            if (ptr && ptr == m_arena.m_last) {
+                m_arena.m_pos = m_arena.m_last;
+                m_arena.m_last = NULL;
+            }
+        }
+    };
+
+    Operator operate(const char*) {
+        return Operator(*this);
+    }
+};
+
+} // namespace turf
+
+#endif // TURF_ARENA_H
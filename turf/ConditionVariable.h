@@ -20,7 +20,10 @@
 
 // Choose default implementation if not already configured by turf_userconfig.h:
 #if !defined(TURF_IMPL_CONDITIONVARIABLE_PATH)
-    #if TURF_PREFER_CPP11
+    #if TURF_USE_FUTEX && TURF_KERNEL_LINUX
+        #define TURF_IMPL_CONDITIONVARIABLE_PATH "impl/ConditionVariable_Futex.h"
+        #define TURF_IMPL_CONDITIONVARIABLE_TYPE turf::ConditionVariable_Futex
+    #elif TURF_PREFER_CPP11
         #define TURF_IMPL_CONDITIONVARIABLE_PATH "impl/ConditionVariable_CPP11.h"
         #define TURF_IMPL_CONDITIONVARIABLE_TYPE turf::ConditionVariable_CPP11
     // FIXME: Implement ConditionVariable_Boost
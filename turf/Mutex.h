@@ -22,9 +22,18 @@ class LockGuard;
 
 // clang-format off
 
-// Choose default implementation if not already configured by turf_userconfig.h:
+// Choose default implementation if not already configured by turf_userconfig.h.
+// Besides the defaults below, turf_userconfig.h can select one of the non-recursive
+// alternatives that work when zero-init at global scope:
+//   impl/Mutex_Futex.h   turf::Mutex_Futex    (Linux only; also enabled by TURF_USE_FUTEX)
+//   impl/Mutex_Ticket.h  turf::Mutex_Ticket   (fair spinlock)
+//   impl/Mutex_MCS.h     turf::Mutex_MCS      (fair queue lock with local spinning)
 #if !defined(TURF_IMPL_MUTEX_PATH)
-    #if TURF_PREFER_CPP11
+    #if TURF_USE_FUTEX && TURF_KERNEL_LINUX
+        // Note: Unlike Mutex_POSIX, this one is not recursive.
+        #define TURF_IMPL_MUTEX_PATH "impl/Mutex_Futex.h"
+        #define TURF_IMPL_MUTEX_TYPE turf::Mutex_Futex
+    #elif TURF_PREFER_CPP11
         #define TURF_IMPL_MUTEX_PATH "impl/Mutex_CPP11.h"
         #define TURF_IMPL_MUTEX_TYPE turf::Mutex_CPP11
     #elif TURF_PREFER_BOOST
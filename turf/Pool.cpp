@@ -0,0 +1,188 @@
+/*------------------------------------------------------------------------
+  Turf: Configurable C++ platform adapter
+  Copyright (c) 2016 Jeff Preshing
+
+  Distributed under the Simplified BSD License.
+  Original location: https://github.com/preshing/turf
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the LICENSE file for more information.
+------------------------------------------------------------------------*/
+
+#include <turf/Core.h>
+#include <turf/Pool.h>
+#include <turf/MemPage.h>
+#include <turf/Util.h>
+#include <turf/Assert.h>
+
+namespace turf {
+
+TURF_THREAD_LOCAL FixedSizeAllocator::Magazine* FixedSizeAllocator::s_magazine = NULL;
+
+FixedSizeAllocator::FixedSizeAllocator(ureg blockSize, ureg slabSize)
+    : m_depot(0), m_slabs(NULL), m_carvePos(NULL), m_carveEnd(NULL), m_numSlabs(0), m_magazines(NULL) {
+    m_blockSize = util::align(util::max<ureg>(blockSize, sizeof(Block)), sizeof(Block));
+    if (slabSize == 0)
+        slabSize = util::max<ureg>(65536, TURF_CACHE_LINE_SIZE + 16 * MagazineSize * m_blockSize);
+    ureg allocAlignment;
+    ureg pageSize = MemPage::getPageSize(allocAlignment);
+    m_slabSize = util::align(slabSize, pageSize);
+    TURF_ASSERT(m_slabSize >= TURF_CACHE_LINE_SIZE + m_blockSize);
+}
+
+FixedSizeAllocator::~FixedSizeAllocator() {
+    // Magazines belong to their threads, which may use them again for another allocator.
+    for (Magazine* mag = m_magazines; mag; mag = mag->nextInAllocator)
+        mag->owner = NULL;
+    Slab* slab = m_slabs;
+    while (slab) {
+        Slab* next = slab->next;
+        MemPage::free(slab, m_slabSize);
+        slab = next;
+    }
+}
+
+FixedSizeAllocator::Magazine* FixedSizeAllocator::getMagazineSlow() {
+    // Look for this allocator's magazine among the other magazines used by this thread, and move it to the front.
+    // Along the way, remember any magazine left behind by a destroyed allocator.
+    Magazine* orphan = NULL;
+    Magazine* prev = NULL;
+    for (Magazine* mag = s_magazine; mag; prev = mag, mag = mag->nextInThread) {
+        if (mag->owner == this) {
+            if (prev) {
+                prev->nextInThread = mag->nextInThread;
+                mag->nextInThread = s_magazine;
+                s_magazine = mag;
+            }
+            return mag;
+        }
+        if (!mag->owner && !orphan)
+            orphan = mag;
+    }
+
+    // First time this thread uses this allocator.
+    TID::TID tid = TID::getCurrentThreadID();
+    LockGuard<Mutex> guard(m_mutex);
+    // If a thread that exited had the same ID, adopt its magazine, along with any blocks still in it.
+    Magazine* mag = m_magazines;
+    while (mag && mag->tid != tid)
+        mag = mag->nextInAllocator;
+    if (mag) {
+        mag->nextInThread = s_magazine;
+        s_magazine = mag;
+        return mag;
+    }
+    if (orphan) {
+        // Already in this thread's list.
+        mag = orphan;
+    } else {
+        mag = (Magazine*) TURF_HEAP.alloc(sizeof(Magazine));
+        TURF_ASSERT(mag);
+        mag->nextInThread = s_magazine;
+        s_magazine = mag;
+    }
+    mag->owner = this;
+    mag->tid = tid;
+    mag->head = NULL;
+    mag->count = 0;
+    mag->full = NULL;
+    mag->nextInAllocator = m_magazines;
+    m_magazines = mag;
+    return mag;
+}
+
+void* FixedSizeAllocator::refill(Magazine* mag) {
+    Block* chain = mag->full;
+    mag->full = NULL;
+    if (!chain)
+        chain = popChain();
+    if (!chain)
+        chain = carveChain();
+    if (!chain)
+        return NULL;
+    mag->head = chain->next;
+    mag->count = getChainLength(chain) - 1;
+    return chain;
+}
+
+void FixedSizeAllocator::overflow(Magazine* mag) {
+    if (mag->full)
+        pushChain(mag->full);
+    mag->full = mag->head;
+    setChainLength(mag->full, mag->count);
+    mag->head = NULL;
+    mag->count = 0;
+}
+
+void FixedSizeAllocator::flushThreadCache() {
+    Magazine* mag = getMagazine();
+    if (mag->full)
+        pushChain(mag->full);
+    if (mag->head) {
+        setChainLength(mag->head, mag->count);
+        pushChain(mag->head);
+    }
+    mag->head = NULL;
+    mag->count = 0;
+    mag->full = NULL;
+}
+
+void FixedSizeAllocator::pushChain(Block* chain) {
+    u64 oldDepot = m_depot.load(turf::Relaxed);
+    do {
+        chain->nextChain = unpack(oldDepot);
+    } while (!m_depot.compareExchangeWeak(oldDepot, pack(chain, oldDepot), turf::Release, turf::Relaxed));
+}
+
+FixedSizeAllocator::Block* FixedSizeAllocator::popChain() {
+    u64 oldDepot = m_depot.load(turf::Acquire);
+    for (;;) {
+        Block* chain = unpack(oldDepot);
+        if (!chain)
+            return NULL;
+        // If another thread pops this chain first, this may read garbage, but then the tag has changed and the CAS fails.
+        Block* nextChain = chain->nextChain;
+        if (m_depot.compareExchangeWeak(oldDepot, pack(nextChain, oldDepot), turf::Acquire, turf::Acquire))
+            return chain;
+    }
+}
+
+FixedSizeAllocator::Block* FixedSizeAllocator::carveChain() {
+    LockGuard<Mutex> guard(m_mutex);
+    // Another thread may have filled the depot while we waited for the lock.
+    Block* chain = popChain();
+    if (chain)
+        return chain;
+    if (m_carvePos + m_blockSize > m_carveEnd) {
+        void* mem;
+        if (!MemPage::alloc(mem, m_slabSize))
+            return NULL;
+        if ((((uptr) mem + m_slabSize - 1) & ~PointerMask) != 0) {
+            // Blocks here couldn't be packed into the depot's head pointer.
+            MemPage::free(mem, m_slabSize);
+            return NULL;
+        }
+        Slab* slab = (Slab*) mem;
+        slab->next = m_slabs;
+        m_slabs = slab;
+        m_numSlabs++;
+        m_carvePos = (u8*) slab + TURF_CACHE_LINE_SIZE;
+        m_carveEnd = (u8*) slab + m_slabSize;
+    }
+    // The last chain in a slab may be short.
+    ureg count = util::min<ureg>(MagazineSize, (m_carveEnd - m_carvePos) / m_blockSize);
+    chain = (Block*) m_carvePos;
+    Block* block = chain;
+    for (ureg i = 1; i < count; i++) {
+        Block* next = (Block*) ((u8*) block + m_blockSize);
+        block->next = next;
+        block = next;
+    }
+    block->next = NULL;
+    setChainLength(chain, count);
+    m_carvePos += count * m_blockSize;
+    return chain;
+}
+
+} // namespace turf
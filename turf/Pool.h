@@ -0,0 +1,212 @@
+/*------------------------------------------------------------------------
+  Turf: Configurable C++ platform adapter
+  Copyright (c) 2016 Jeff Preshing
+
+  Distributed under the Simplified BSD License.
+  Original location: https://github.com/preshing/turf
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the LICENSE file for more information.
+------------------------------------------------------------------------*/
+
+#ifndef TURF_POOL_H
+#define TURF_POOL_H
+
+#include <turf/Core.h>
+#include <turf/Atomic.h>
+#include <turf/Mutex.h>
+#include <turf/TID.h>
+#include <turf/Heap.h>
+
+namespace turf {
+
+//---------------------------------------------------------
+// FixedSizeAllocator
+// Hands out blocks of a single size, carved from slabs allocated with MemPage.
+// Each thread keeps a magazine of free blocks, so most alloc() and free() calls are a few loads and stores.
+// Magazines exchange whole chains of MagazineSize blocks with a shared lock-free stack, the depot.
+// Only carving a new chain from a slab takes the mutex.
+// Slabs are only returned to the system when the allocator is destroyed, which must not happen while
+// any thread is still using it.
+//---------------------------------------------------------
+class FixedSizeAllocator {
+private:
+    static const ureg MagazineSize = 32;
+
+    // Layout of a free block. The second word of a chain's first block links to the next chain in the depot,
+    // and the second word of its second block holds the chain's length. A chain of one block has no second block.
+    struct Block {
+        Block* next;
+        union {
+            Block* nextChain;
+            ureg chainLength;
+        };
+    };
+
+    struct Slab {
+        Slab* next;
+    };
+
+    // Holds up to 2 * MagazineSize blocks: a partial chain, plus one full chain in reserve.
+    struct Magazine {
+        FixedSizeAllocator* owner; // NULL once the owner is destroyed
+        TID::TID tid;
+        Magazine* nextInAllocator; // Protected by owner->m_mutex
+        Magazine* nextInThread;    // Next magazine used by the same thread, for another allocator
+        Block* head;
+        ureg count; // Length of head
+        Block* full;
+    };
+
+    // The depot's head pointer, packed with a tag that changes on every push and pop to avoid ABA.
+    // Blocks popped by a stale reader may have been reused, but they're never unmapped, so reading them is safe.
+#if TURF_PTR_SIZE == 8
+    // User space addresses fit in 48 bits unless the OS maps memory above that, as Linux can with 5-level paging.
+    // carveChain() checks every slab, so blocks never lie outside PointerMask.
+    static const u64 PointerMask = (u64(1) << 48) - 1;
+    static const u32 TagShift = 48;
+#else
+    static const u64 PointerMask = 0xffffffffu;
+    static const u32 TagShift = 32;
+#endif
+    Atomic<u64> m_depot;
+
+    ureg m_blockSize;
+    ureg m_slabSize;
+    Mutex m_mutex;
+    Slab* m_slabs;          // Protected by m_mutex
+    u8* m_carvePos;         // Protected by m_mutex
+    u8* m_carveEnd;         // Protected by m_mutex
+    ureg m_numSlabs;        // Protected by m_mutex
+    Magazine* m_magazines;  // Protected by m_mutex
+
+    static TURF_THREAD_LOCAL Magazine* s_magazine; // Most recently used by the current thread
+
+    static Block* unpack(u64 tagged) {
+        return (Block*) (uptr)(tagged & PointerMask);
+    }
+
+    static u64 pack(Block* block, u64 previous) {
+        return (u64)(uptr) block | ((previous >> TagShift) + 1) << TagShift;
+    }
+
+    static void setChainLength(Block* chain, ureg length) {
+        if (chain->next)
+            chain->next->chainLength = length;
+    }
+
+    static ureg getChainLength(Block* chain) {
+        return chain->next ? chain->next->chainLength : 1;
+    }
+
+    Magazine* getMagazine() {
+        Magazine* mag = s_magazine;
+        if (mag && mag->owner == this)
+            return mag;
+        return getMagazineSlow();
+    }
+
+    TURF_NO_INLINE Magazine* getMagazineSlow();
+    TURF_NO_INLINE void* refill(Magazine* mag);
+    TURF_NO_INLINE void overflow(Magazine* mag);
+    void pushChain(Block* chain); // The chain's length must be set
+    Block* popChain();
+    Block* carveChain();
+
+    // Not copyable
+    FixedSizeAllocator(const FixedSizeAllocator&);
+    FixedSizeAllocator& operator=(const FixedSizeAllocator&);
+
+public:
+    // Blocks are rounded up to a multiple of 2 * sizeof(void*), which is also their alignment.
+    // If slabSize is 0, a size that fits at least 16 chains of blocks is chosen.
+    FixedSizeAllocator(ureg blockSize, ureg slabSize = 0);
+    ~FixedSizeAllocator();
+
+    void* alloc() {
+        Magazine* mag = getMagazine();
+        Block* block = mag->head;
+        if (!block)
+            return refill(mag);
+        mag->head = block->next;
+        mag->count--;
+        return block;
+    }
+
+    void free(void* ptr) {
+        Magazine* mag = getMagazine();
+        if (mag->count >= MagazineSize)
+            overflow(mag);
+        Block* block = (Block*) ptr;
+        block->next = mag->head;
+        mag->head = block;
+        mag->count++;
+    }
+
+    // Returns the calling thread's cached blocks to the depot, where other threads can use them.
+    // Threads that exit without calling this leave their blocks to the next thread that reuses their ID.
+    void flushThreadCache();
+
+    ureg getBlockSize() const {
+        return m_blockSize;
+    }
+
+    ureg getNumSlabs() {
+        LockGuard<Mutex> guard(m_mutex);
+        return m_numSlabs;
+    }
+};
+
+//---------------------------------------------------------
+// Pool
+// A FixedSizeAllocator for objects of type T. alloc() returns uninitialized storage.
+//---------------------------------------------------------
+template <typename T>
+class Pool : public FixedSizeAllocator {
+private:
+    // The offset of value is alignof(T), even without C++11.
+    struct AlignmentProbe {
+        char c;
+        T value;
+    };
+    TURF_STATIC_ASSERT(sizeof(AlignmentProbe) - sizeof(T) <= 2 * sizeof(void*));
+
+public:
+    Pool(ureg slabSize = 0) : FixedSizeAllocator(sizeof(T), slabSize) {
+    }
+
+    T* alloc() {
+        return (T*) FixedSizeAllocator::alloc();
+    }
+
+    void free(T* ptr) {
+        FixedSizeAllocator::free(ptr);
+    }
+
+    // The pool shared by every user of T. Created on first use, and never destroyed,
+    // so that objects can safely be deleted during static destruction.
+    static Pool& instance() {
+        static Pool* pool = new Pool;
+        return *pool;
+    }
+};
+
+} // namespace turf
+
+// Place in the body of class T to allocate instances of T, created with new, from turf::Pool<T>::instance().
+// Subclasses of a different size go to TURF_HEAP instead.
+#define TURF_USE_POOL(T) \
+    static void* operator new(size_t size) { \
+        return size == sizeof(T) ? (void*) turf::Pool<T>::instance().alloc() : TURF_HEAP.alloc(size); \
+    } \
+    static void operator delete(void* ptr, size_t size) { \
+        if (!ptr) \
+            return; \
+        if (size == sizeof(T)) \
+            turf::Pool<T>::instance().free((T*) ptr); \
+        else \
+            TURF_HEAP.free(ptr); \
+    }
+
+#endif // TURF_POOL_H
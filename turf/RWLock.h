@@ -17,7 +17,9 @@
 
 // clang-format off
 
-// Choose default implementation if not already configured by turf_userconfig.h:
+// Choose default implementation if not already configured by turf_userconfig.h.
+// For read-mostly data, turf_userconfig.h can instead select:
+//   impl/RWLock_Distributed.h  turf::RWLock_Distributed  (scalable readers, writer-preferring)
 #if !defined(TURF_IMPL_RWLOCK_PATH)
     // FIXME: Implement RWLock_CPP11/14, RWLock_Boost
     #if TURF_TARGET_WIN32
@@ -0,0 +1,127 @@
+/*------------------------------------------------------------------------
+  Turf: Configurable C++ platform adapter
+  Copyright (c) 2016 Jeff Preshing
+
+  Distributed under the Simplified BSD License.
+  Original location: https://github.com/preshing/turf
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the LICENSE file for more information.
+------------------------------------------------------------------------*/
+
+#ifndef TURF_SEQLOCK_H
+#define TURF_SEQLOCK_H
+
+#include <turf/Core.h>
+#include <turf/Atomic.h>
+#include <turf/AdaptiveBackoff.h>
+
+namespace turf {
+
+//---------------------------------------------------------
+// SeqLock
+// For data that is read often and written rarely. Readers never write to shared memory;
+// instead, they retry if a writer was active during the read:
+//
+//     u32 seq;
+//     do {
+//         seq = lock.beginRead();
+//         ... copy the data ...
+//     } while (lock.retryRead(seq));
+//
+// Data read between beginRead() and retryRead() may be torn, so readers must only copy it,
+// and not act on it, until retryRead() returns false.
+// Writers are serialized with each other. Works when zero-init at global scope.
+//---------------------------------------------------------
+class SeqLock {
+private:
+    // Odd while a write is in progress.
+    Atomic<u32> m_sequence;
+
+public:
+    SeqLock() : m_sequence(0) {
+    }
+
+    u32 beginRead() const {
+        u32 seq = m_sequence.load(turf::Acquire);
+        if (seq & 1) {
+            AdaptiveBackoff backoff;
+            do {
+                backoff.wait();
+                seq = m_sequence.load(turf::Acquire);
+            } while (seq & 1);
+        }
+        return seq;
+    }
+
+    bool retryRead(u32 seq) const {
+        // Keep the data loads above from moving below the sequence check.
+        turf::threadFenceAcquire();
+        return m_sequence.load(turf::Relaxed) != seq;
+    }
+
+    void beginWrite() {
+        u32 seq = m_sequence.load(turf::Relaxed);
+        AdaptiveBackoff backoff;
+        for (;;) {
+            if ((seq & 1) == 0 && m_sequence.compareExchangeStrong(seq, seq + 1, turf::Acquire))
+                break;
+            backoff.wait();
+            seq = m_sequence.load(turf::Relaxed);
+        }
+        // Make the odd sequence visible before any of the data stores that follow.
+        turf::threadFenceRelease();
+    }
+
+    void endWrite() {
+        // Only the writer modifies m_sequence while it's odd.
+        m_sequence.store(m_sequence.loadNonatomic() + 1, turf::Release);
+    }
+};
+
+//---------------------------------------------------------
+// SeqLockProtected
+// A value of type T guarded by a SeqLock. load() returns a consistent snapshot
+// without writing to shared memory. T must be trivially copyable.
+//---------------------------------------------------------
+template <typename T>
+class SeqLockProtected {
+private:
+    SeqLock m_lock;
+    T m_value;
+
+public:
+    SeqLockProtected() : m_value() {
+    }
+
+    SeqLockProtected(const T& value) : m_value(value) {
+    }
+
+    T load() const {
+        for (;;) {
+            u32 seq = m_lock.beginRead();
+            T copy = m_value;
+            if (!m_lock.retryRead(seq))
+                return copy;
+        }
+    }
+
+    void store(const T& value) {
+        m_lock.beginWrite();
+        m_value = value;
+        m_lock.endWrite();
+    }
+
+    // Read-modify-write of the protected value. Func is called as func(T&) with writers excluded.
+    template <typename Func>
+    void modify(Func func) {
+        m_lock.beginWrite();
+        func(m_value);
+        m_lock.endWrite();
+    }
+};
+
+} // namespace turf
+
+#endif // TURF_SEQLOCK_H
@@ -95,6 +95,11 @@ typedef uintptr_t uintreg_t;
 #define TURF_STATIC_ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
 #define TURF_UNUSED(x) ((void) x)
 
+// Granularity used to pad data apart and avoid false sharing.
+#ifndef TURF_CACHE_LINE_SIZE
+    #define TURF_CACHE_LINE_SIZE 64
+#endif
+
 //---------------------------------------------
 // Format strings
 //---------------------------------------------
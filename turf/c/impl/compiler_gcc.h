@@ -36,7 +36,7 @@
 //  CPU intrinsics
 //-------------------------------------
 TURF_C_INLINE void turf_yieldHWThread() {
-#if MINT_CPU_X86 || MINT_CPU_X64
+#if TURF_CPU_X86 || TURF_CPU_X64
     // Only implemented on x86/64
     asm volatile("pause");
 #endif
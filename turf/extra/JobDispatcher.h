@@ -16,18 +16,35 @@
 #include <turf/Core.h>
 #include <turf/Assert.h>
 #include <turf/Affinity.h>
-#include <turf/extra/SpinKicker.h>
+#include <turf/Atomic.h>
+#include <turf/Thread.h>
+#include <turf/Util.h>
+#include <turf/AdaptiveBackoff.h>
+#include <turf/extra/LightweightSemaphore.h>
 #include <vector>
 
 namespace turf {
 namespace extra {
 
+//---------------------------------------------------------
+// JobDispatcher
+// Runs a function on a pool of threads, one of which is the thread that owns the dispatcher.
+// Between jobs, workers spin for a while in case another job follows right away, then park, so that an idle
+// pool doesn't burn its cores. Each job only wakes the workers it runs on. Once awake, the threads running a job
+// meet at a start barrier, so that they all begin at the same instant, which stress tests rely on.
+//
+// Jobs are any callable taking the thread index: C++11 lambdas, functors, or function pointers. kick() runs one
+// on every thread and returns when they're done. submit() runs one on the spawned threads only and returns a
+// Future right away, so the owner can do its own work in the meantime. Only one job runs at a time; starting
+// another one, or resizing the pool, first waits for the submitted job. Only the owner may call these.
+//---------------------------------------------------------
 class JobDispatcher {
 private:
     struct WorkerThread {
         JobDispatcher* dispatcher;
         ureg threadIndex;
         turf::Thread thread;
+        LightweightSemaphore wakeUp; // Signaled once for each job this thread must run
         bool mustExit;
 
         WorkerThread(JobDispatcher* dispatcher, ureg threadIndex)
@@ -36,28 +53,33 @@ private:
     };
 
     typedef void Action(void*, ureg);
+    typedef void Deleter(void*);
 
     turf::Affinity m_affinity;
     bool m_useAffinities;
     std::vector<WorkerThread*> m_threads;
-    sreg m_threadFilter;
     Action* m_action;
     void* m_param;
-    turf::extra::SpinKicker m_startGate;
-    turf::extra::SpinKicker m_endGate;
+    AdaptiveBackoff::Params m_idleBackoff; // How long idle threads wait for the next job before parking
+    Atomic<ureg> m_numStarting; // Threads that haven't reached the current job's start barrier
+    Atomic<ureg> m_numRunning;  // Woken workers that haven't finished the current job
+    LightweightSemaphore m_jobDone;
+    ureg m_lastJobID;
+    ureg m_asyncJobID;      // The submitted job that's still running, or 0
+    Deleter* m_asyncDelete; // Frees m_param once the submitted job is done
 
     void threadRun(WorkerThread* thread) {
         if (m_useAffinities)
             m_affinity.setAffinity(thread->threadIndex, 0);
         for (;;) {
-            m_startGate.waitForKick();
-            // Need to fetch the WorkerThread struct on each kick since
-            // the array can resize between kicks.
+            thread->wakeUp.wait(m_idleBackoff);
             if (thread->mustExit)
                 break;
-            if (m_threadFilter < 0 || m_threadFilter == thread->threadIndex)
-                m_action(m_param, thread->threadIndex);
-            m_endGate.waitForKick();
+            waitForStart();
+            m_action(m_param, thread->threadIndex);
+            // The last worker to finish lets the owner know. AcquireRelease so that the owner sees everyone's results.
+            if (m_numRunning.fetchSub(1, turf::AcquireRelease) == 1)
+                m_jobDone.signal();
         }
     }
 
@@ -70,14 +92,112 @@ private:
     static void noAction(void*, ureg) {
     }
 
+    template <class Fn>
+    static void callAction(void* param, ureg threadIndex) {
+        (*(Fn*) param)(threadIndex);
+    }
+
+    template <class Fn>
+    static void deleteAction(void* param) {
+        delete (Fn*) param;
+    }
+
+    template <class T>
+    struct MemberAction {
+        void (T::*pmf)(ureg);
+        T* target;
+        void operator()(ureg threadIndex) {
+            TURF_CALL_MEMBER (*target, pmf)(threadIndex);
+        }
+    };
+
+    template <class T>
+    struct MemberActionNoIndex {
+        void (T::*pmf)();
+        T* target;
+        void operator()(ureg) {
+            TURF_CALL_MEMBER (*target, pmf)();
+        }
+    };
+
+    template <class T>
+    struct MultiAction {
+        void (T::*pmf)();
+        T* targets;
+        void operator()(ureg threadIndex) {
+            TURF_CALL_MEMBER(targets[threadIndex], pmf)();
+        }
+    };
+
     void resetAction() {
-        m_threadFilter = -1;
         m_action = noAction;
         m_param = NULL;
     }
 
+    // fn must outlive the job.
+    template <class Fn>
+    void setAction(Fn& fn) {
+        waitForAsyncJob();
+        m_action = callAction<Fn>;
+        m_param = &fn;
+    }
+
+    // Wakes the worker threads in [first, last) to run the current action, and returns how many were woken.
+    // If first is 0, the calling thread takes part in the start barrier too.
+    ureg wakeWorkers(ureg first, ureg last) {
+        ureg firstWorker = util::max<ureg>(first, 1);
+        ureg numWoken = last > firstWorker ? last - firstWorker : 0;
+        // Published by the signals below
+        m_numStarting.store(numWoken + (first == 0 ? 1 : 0), turf::Relaxed);
+        m_numRunning.store(numWoken, turf::Relaxed);
+        for (ureg t = firstWorker; t < last; t++)
+            m_threads[t]->wakeUp.signal();
+        return numWoken;
+    }
+
+    // Checks in at the start barrier and waits for the other threads running the job. They're all awake by now,
+    // so this spins and yields, but never parks. The counter can't be reset under a thread that's still waiting
+    // here, since the next job only starts once this one is done.
+    void waitForStart() {
+        m_numStarting.fetchSub(1, turf::Relaxed);
+        AdaptiveBackoff backoff;
+        while (m_numStarting.load(turf::Relaxed) != 0)
+            backoff.wait();
+    }
+
+    // Runs the current action on threads [first, last) and waits for them. Thread 0 is the calling thread.
+    void runAction(ureg first, ureg last) {
+        ureg numWoken = wakeWorkers(first, last);
+        if (first == 0) {
+            waitForStart();
+            m_action(m_param, 0);
+        }
+        if (numWoken > 0) {
+            // Jobs are often short, so spin a while before parking.
+            m_jobDone.wait(m_idleBackoff);
+        }
+        resetAction();
+    }
+
+    bool isJobDone(ureg jobID) const {
+        return jobID != m_asyncJobID || m_numRunning.load(turf::Acquire) == 0;
+    }
+
+    void waitForAsyncJob() {
+        if (m_asyncJobID == 0)
+            return;
+        m_jobDone.wait(m_idleBackoff);
+        m_asyncDelete(m_param);
+        resetAction();
+        m_asyncJobID = 0;
+    }
+
 public:
-    JobDispatcher(ureg numThreads = 0) : m_useAffinities(numThreads == 0) {
+    // idleBackoff sets how long threads poll for the next job before parking. Polling longer lowers the latency of
+    // back-to-back jobs, but takes CPU time from other processes while the pool is idle. Params(0, 0) parks right away.
+    JobDispatcher(ureg numThreads = 0, const AdaptiveBackoff::Params& idleBackoff = AdaptiveBackoff::Params())
+        : m_useAffinities(numThreads == 0), m_idleBackoff(idleBackoff), m_numStarting(0), m_numRunning(0), m_lastJobID(0),
+          m_asyncJobID(0), m_asyncDelete(NULL) {
         m_threads.push_back(new WorkerThread(this, 0));
         if (m_useAffinities)
             m_affinity.setAffinity(0, 0);
@@ -95,23 +215,28 @@ public:
         return m_affinity.getNumPhysicalCores();
     }
 
+    // Including the thread that owns the dispatcher.
+    ureg getNumThreads() const {
+        return m_threads.size();
+    }
+
     void setNumSpawnedThreads(ureg numThreads) {
         TURF_ASSERT(numThreads > 0);
+        waitForAsyncJob();
         if (m_useAffinities)
             TURF_ASSERT(numThreads <= m_affinity.getNumPhysicalCores());
         ureg oldNumThreads = m_threads.size();
         if (numThreads < oldNumThreads) {
-            resetAction();
+            // Only wake the threads that must exit.
             for (ureg t = numThreads; t < oldNumThreads; t++) {
                 m_threads[t]->mustExit = true;
+                m_threads[t]->wakeUp.signal();
             }
-            m_startGate.kick(oldNumThreads - 1);
             for (ureg t = numThreads; t < oldNumThreads; t++) {
                 m_threads[t]->thread.join();
                 delete m_threads[t];
             }
             m_threads.resize(numThreads);
-            m_endGate.kick(numThreads - 1);
         } else {
             for (; oldNumThreads < numThreads; oldNumThreads++) {
                 WorkerThread* thread = new WorkerThread(this, oldNumThreads);
@@ -121,91 +246,90 @@ public:
         }
     }
 
+    //---------------------------------------------------------
+    // Future
+    // Returned by submit(). Copyable; all copies refer to the same job.
+    //---------------------------------------------------------
+    class Future {
+    private:
+        friend class JobDispatcher;
+        JobDispatcher* m_dispatcher;
+        ureg m_jobID;
+
+        Future(JobDispatcher* dispatcher, ureg jobID) : m_dispatcher(dispatcher), m_jobID(jobID) {
+        }
+
+    public:
+        // A default-constructed Future is always ready.
+        Future() : m_dispatcher(NULL), m_jobID(0) {
+        }
+
+        bool isReady() const {
+            return !m_dispatcher || m_dispatcher->isJobDone(m_jobID);
+        }
+
+        // Must be called from the thread that owns the dispatcher.
+        void wait() {
+            if (m_dispatcher && m_dispatcher->m_asyncJobID == m_jobID)
+                m_dispatcher->waitForAsyncJob();
+        }
+    };
+
+    // Calls fn(threadIndex) on every thread, including this one as thread 0, and waits for them.
+    template <class Fn>
+    void kick(Fn fn) {
+        setAction(fn);
+        runAction(0, m_threads.size());
+    }
+
     template <class T>
-    void kickOne(ureg threadIndex, void (T::*pmf)(), T& target) {
-        // Define the action
-        struct Closure {
-            void (T::*pmf)();
-            T* target;
-            static void thunk(void* param, ureg) {
-                Closure* self = (Closure*) param;
-                TURF_CALL_MEMBER (*self->target, self->pmf)();
-            }
-        };
-        Closure closure = {pmf, &target};
-        m_threadFilter = threadIndex;
-        m_action = Closure::thunk;
-        m_param = &closure;
-        // Kick the threads
+    void kick(void (T::*pmf)(ureg), T& target) {
+        MemberAction<T> action = {pmf, &target};
+        kick(action);
+    }
+
+    // Calls fn(threadIndex) on one thread, spawning threads up to it if needed, and waits for it.
+    template <class Fn>
+    void kickOne(ureg threadIndex, Fn fn) {
+        setAction(fn);
         if (threadIndex >= m_threads.size())
             setNumSpawnedThreads(threadIndex + 1);
-        m_startGate.kick(m_threads.size() - 1);
-        if (threadIndex == 0)
-            m_action(m_param, 0);
-        m_endGate.kick(m_threads.size() - 1);
-        resetAction();
+        runAction(threadIndex, threadIndex + 1);
     }
 
     template <class T>
-    void kickMulti(void (T::*pmf)(), T* targets, ureg numTargets) {
-        // Define the action
-        struct Closure {
-            void (T::*pmf)();
-            T* targets;
-            static void thunk(void* param, ureg index) {
-                Closure* self = (Closure*) param;
-                TURF_CALL_MEMBER(self->targets[index], self->pmf)();
-            }
-        };
-        Closure closure = {pmf, targets};
-        m_action = Closure::thunk;
-        m_param = &closure;
-        // Kick the threads
-        setNumSpawnedThreads(numTargets);
-        m_startGate.kick(m_threads.size() - 1);
-        m_action(m_param, 0);
-        m_endGate.kick(m_threads.size() - 1);
-        resetAction();
+    void kickOne(ureg threadIndex, void (T::*pmf)(), T& target) {
+        MemberActionNoIndex<T> action = {pmf, &target};
+        kickOne(threadIndex, action);
     }
 
+    // Resizes the pool to numTargets threads, and calls pmf on each target from its own thread.
     template <class T>
-    void kick(void (T::*pmf)(ureg), T& target) {
-        // Define the action
-        struct Closure {
-            void (T::*pmf)(ureg);
-            T* target;
-            static void thunk(void* param, ureg index) {
-                Closure* self = (Closure*) param;
-                TURF_CALL_MEMBER (*self->target, self->pmf)(index);
-            }
-        };
-        Closure closure = {pmf, &target};
-        m_action = Closure::thunk;
-        m_param = &closure;
-        // Kick the threads
-        m_startGate.kick(m_threads.size() - 1);
-        m_action(m_param, 0);
-        m_endGate.kick(m_threads.size() - 1);
-        resetAction();
+    void kickMulti(void (T::*pmf)(), T* targets, ureg numTargets) {
+        MultiAction<T> action = {pmf, targets};
+        setNumSpawnedThreads(numTargets);
+        kick(action);
     }
 
-    void kick(void (*func)(ureg)) {
-        // Define the action
-        struct Closure {
-            void (*func)(ureg);
-            static void thunk(void* param, ureg index) {
-                Closure* self = (Closure*) param;
-                self->func(index);
-            }
-        };
-        Closure closure = {func};
-        m_action = Closure::thunk;
-        m_param = &closure;
-        // Kick the threads
-        m_startGate.kick(m_threads.size() - 1);
-        m_action(m_param, 0);
-        m_endGate.kick(m_threads.size() - 1);
-        resetAction();
+    // Calls fn(threadIndex) on every spawned thread, leaving this thread free, and returns without waiting.
+    // fn is copied, so it may refer to the caller's stack only if the caller waits before that goes away.
+    // If no threads are spawned, runs fn(0) on this thread before returning.
+    template <class Fn>
+    Future submit(Fn fn) {
+        waitForAsyncJob();
+        if (m_threads.size() <= 1) {
+            fn(0);
+            return Future();
+        }
+        Fn* copy = new Fn(TURF_MOVE(fn));
+        m_action = callAction<Fn>;
+        m_param = copy;
+        m_asyncDelete = deleteAction<Fn>;
+        if (++m_lastJobID == 0)
+            m_lastJobID = 1; // Zero means no job
+        m_asyncJobID = m_lastJobID;
+        wakeWorkers(1, m_threads.size());
+        return Future(this, m_asyncJobID);
     }
 };
 
@@ -0,0 +1,66 @@
+/*------------------------------------------------------------------------
+  Turf: Configurable C++ platform adapter
+  Copyright (c) 2016 Jeff Preshing
+
+  Distributed under the Simplified BSD License.
+  Original location: https://github.com/preshing/turf
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the LICENSE file for more information.
+------------------------------------------------------------------------*/
+
+#ifndef TURF_EXTRA_LIGHTWEIGHTSEMAPHORE_H
+#define TURF_EXTRA_LIGHTWEIGHTSEMAPHORE_H
+
+#include <turf/Core.h>
+#include <turf/Atomic.h>
+#include <turf/Semaphore.h>
+#include <turf/AdaptiveBackoff.h>
+
+namespace turf {
+namespace extra {
+
+//---------------------------------------------------------
+// LightweightSemaphore
+// A counting semaphore that only makes a syscall when a thread actually has to sleep or be woken.
+// wait() polls the count through the spin and yield rounds of an AdaptiveBackoff, then parks on a turf::Semaphore.
+// The count goes negative by the number of parked threads, so signal() knows how many to wake.
+//---------------------------------------------------------
+class LightweightSemaphore {
+private:
+    Atomic<sreg> m_count;
+    turf::Semaphore m_sema;
+
+public:
+    LightweightSemaphore(sreg initialCount = 0) : m_count(initialCount) {
+    }
+
+    bool tryWait() {
+        sreg oldCount = m_count.load(turf::Relaxed);
+        return oldCount > 0 && m_count.compareExchangeStrong(oldCount, oldCount - 1, turf::Acquire);
+    }
+
+    void wait(const AdaptiveBackoff::Params& params = AdaptiveBackoff::Params()) {
+        AdaptiveBackoff backoff(params);
+        while (!backoff.isExhausted()) {
+            if (tryWait())
+                return;
+            backoff.wait();
+        }
+        if (m_count.fetchSub(1, turf::Acquire) <= 0)
+            m_sema.wait();
+    }
+
+    void signal(sreg count = 1) {
+        sreg oldCount = m_count.fetchAdd(count, turf::Release);
+        sreg toRelease = -oldCount < count ? -oldCount : count;
+        if (toRelease > 0)
+            m_sema.signal((ureg) toRelease);
+    }
+};
+
+} // namespace extra
+} // namespace turf
+
+#endif // TURF_EXTRA_LIGHTWEIGHTSEMAPHORE_H
@@ -0,0 +1,164 @@
+/*------------------------------------------------------------------------
+  Turf: Configurable C++ platform adapter
+  Copyright (c) 2016 Jeff Preshing
+
+  Distributed under the Simplified BSD License.
+  Original location: https://github.com/preshing/turf
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the LICENSE file for more information.
+------------------------------------------------------------------------*/
+
+#ifndef TURF_EXTRA_PARALLELFOR_H
+#define TURF_EXTRA_PARALLELFOR_H
+
+#include <turf/Core.h>
+#include <turf/Atomic.h>
+#include <turf/Util.h>
+#include <turf/extra/JobDispatcher.h>
+#include <vector>
+
+namespace turf {
+namespace extra {
+
+//---------------------------------------------------------
+// ParallelRange
+// Hands out chunks of [begin, end) to whichever thread asks next, so that threads that get cheap iterations
+// come back for more instead of idling while others finish expensive ones.
+//---------------------------------------------------------
+class ParallelRange {
+private:
+    Atomic<ureg> m_next;
+    ureg m_end;
+    ureg m_grain;
+
+public:
+    ParallelRange(ureg begin, ureg end, ureg grain, ureg numThreads) : m_next(begin), m_end(end), m_grain(grain) {
+        if (m_grain == 0) {
+            // Aim for several chunks per thread, so there's something left to balance the load with.
+            m_grain = util::max<ureg>((end - begin) / (numThreads * 8), 1);
+        }
+    }
+
+    ureg getGrain() const {
+        return m_grain;
+    }
+
+    // Returns false when the range is used up.
+    bool claim(ureg& chunkBegin, ureg& chunkEnd) {
+        // The results are published when each JobDispatcher worker decrements the running count with AcquireRelease
+        // and the last one signals the owner, so the counter doesn't need to order anything.
+        ureg lo = m_next.fetchAdd(m_grain, turf::Relaxed);
+        if (lo >= m_end)
+            return false;
+        chunkBegin = lo;
+        chunkEnd = util::min(lo + m_grain, m_end);
+        return true;
+    }
+};
+
+template <class Fn>
+class ParallelForJob {
+private:
+    ParallelRange m_range;
+    const Fn& m_fn;
+
+public:
+    ParallelForJob(ureg begin, ureg end, ureg grain, ureg numThreads, const Fn& fn)
+        : m_range(begin, end, grain, numThreads), m_fn(fn) {
+    }
+
+    ureg getGrain() const {
+        return m_range.getGrain();
+    }
+
+    void run(ureg) {
+        ureg lo, hi;
+        while (m_range.claim(lo, hi))
+            m_fn(lo, hi);
+    }
+};
+
+template <class T, class Fn, class Combine>
+class ParallelReduceJob {
+private:
+    ParallelRange m_range;
+    const T& m_identity;
+    const Fn& m_fn;
+    const Combine& m_combine;
+    std::vector<T> m_partials;
+
+public:
+    ParallelReduceJob(ureg begin, ureg end, ureg grain, ureg numThreads, const T& identity, const Fn& fn,
+                      const Combine& combine)
+        : m_range(begin, end, grain, numThreads), m_identity(identity), m_fn(fn), m_combine(combine),
+          m_partials(numThreads, identity) {
+    }
+
+    ureg getGrain() const {
+        return m_range.getGrain();
+    }
+
+    void run(ureg threadIndex) {
+        T acc = m_identity;
+        ureg lo, hi;
+        while (m_range.claim(lo, hi))
+            acc = m_combine(acc, m_fn(lo, hi));
+        // Written once per thread, so there's no need to pad the partials apart.
+        m_partials[threadIndex] = acc;
+    }
+
+    T getResult() const {
+        T result = m_identity;
+        for (ureg i = 0; i < m_partials.size(); i++)
+            result = m_combine(result, m_partials[i]);
+        return result;
+    }
+};
+
+//---------------------------------------------------------
+// parallelFor
+// Calls fn(chunkBegin, chunkEnd) on consecutive chunks of [begin, end), using every thread of the dispatcher,
+// and returns when they're all done. Chunks hold grain indices, except the last one. Pass a grain of zero to
+// pick one from the size of the range. Chunks are claimed dynamically, so iterations may vary in cost.
+//---------------------------------------------------------
+template <class Fn>
+void parallelFor(JobDispatcher& dispatcher, ureg begin, ureg end, ureg grain, const Fn& fn) {
+    if (begin >= end)
+        return;
+    ureg numThreads = dispatcher.getNumThreads();
+    ParallelForJob<Fn> job(begin, end, grain, numThreads, fn);
+    if (numThreads == 1 || end - begin <= job.getGrain()) {
+        // Not worth waking the workers.
+        job.run(0);
+        return;
+    }
+    dispatcher.kick(&ParallelForJob<Fn>::run, job);
+}
+
+//---------------------------------------------------------
+// parallelReduce
+// Like parallelFor, but fn(chunkBegin, chunkEnd) returns a T for its chunk. Those are folded together with
+// combine(T, T) -> T, starting from identity, and the result is returned. Since threads claim chunks in no
+// particular order, combine must be associative and commutative.
+//---------------------------------------------------------
+template <class T, class Fn, class Combine>
+T parallelReduce(JobDispatcher& dispatcher, ureg begin, ureg end, ureg grain, const T& identity, const Fn& fn,
+                 const Combine& combine) {
+    if (begin >= end)
+        return identity;
+    ureg numThreads = dispatcher.getNumThreads();
+    ParallelReduceJob<T, Fn, Combine> job(begin, end, grain, numThreads, identity, fn, combine);
+    if (numThreads == 1 || end - begin <= job.getGrain()) {
+        job.run(0);
+        return job.getResult();
+    }
+    dispatcher.kick(&ParallelReduceJob<T, Fn, Combine>::run, job);
+    return job.getResult();
+}
+
+} // namespace extra
+} // namespace turf
+
+#endif // TURF_EXTRA_PARALLELFOR_H
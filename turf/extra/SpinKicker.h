@@ -16,6 +16,7 @@
 #include <turf/Core.h>
 #include <turf/Thread.h>
 #include <turf/Atomic.h>
+#include <turf/AdaptiveBackoff.h>
 
 namespace turf {
 namespace extra {
@@ -33,13 +34,17 @@ public:
         // busy-waiting.
         m_kickVar.fetchAdd(1, turf::Release);
         // Busy-wait on kick variable until there's a kick from main thread.
+        AdaptiveBackoff backoff;
         while (m_kickVar.load(turf::Acquire) > 0) {
+            backoff.wait();
         }
     }
 
     void kick(ureg count) {
         // Wait until all workers are ready and busy-waiting on the kick variable.
+        AdaptiveBackoff backoff;
         while (m_kickVar.load(turf::Acquire) < count) {
+            backoff.wait();
         }
         // Kick.
         m_kickVar.store(0, turf::Release);
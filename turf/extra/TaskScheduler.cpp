@@ -0,0 +1,123 @@
+/*------------------------------------------------------------------------
+  Turf: Configurable C++ platform adapter
+  Copyright (c) 2016 Jeff Preshing
+
+  Distributed under the Simplified BSD License.
+  Original location: https://github.com/preshing/turf
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the LICENSE file for more information.
+------------------------------------------------------------------------*/
+
+#include <turf/Core.h>
+#include <turf/extra/TaskScheduler.h>
+#include <turf/AdaptiveBackoff.h>
+#include <turf/Assert.h>
+
+namespace turf {
+namespace extra {
+
+TURF_THREAD_LOCAL TaskScheduler::Worker* TaskScheduler::s_worker = NULL;
+
+void Task::spawn(Task& child) {
+    TaskScheduler::Worker* worker = TaskScheduler::s_worker;
+    TURF_ASSERT(worker);
+    child.m_parent = this;
+    child.m_pending.storeNonatomic(1);
+    m_pending.fetchAdd(1, turf::Relaxed);
+    worker->deque.push(&child);
+}
+
+void Task::sync() {
+    TaskScheduler::Worker* worker = TaskScheduler::s_worker;
+    TURF_ASSERT(worker);
+    AdaptiveBackoff backoff;
+    while (m_pending.load(turf::Acquire) > 1) {
+        // Children are at the bottom of this worker's deque, unless they were stolen. Either way, keep busy.
+        if (worker->scheduler->runOne(worker))
+            backoff.reset();
+        else
+            backoff.wait();
+    }
+}
+
+TaskScheduler::TaskScheduler(JobDispatcher& dispatcher) : m_dispatcher(dispatcher), m_numWorkers(0), m_done(0) {
+}
+
+TaskScheduler::~TaskScheduler() {
+    for (ureg i = 0; i < m_workers.size(); i++)
+        delete m_workers[i];
+}
+
+void TaskScheduler::run(Task& root) {
+    TURF_ASSERT(!s_worker);
+    m_numWorkers = m_dispatcher.getNumThreads();
+    while (m_workers.size() < m_numWorkers)
+        m_workers.push_back(new Worker(this, m_workers.size()));
+    m_done.storeNonatomic(0);
+    root.m_parent = NULL;
+    root.m_pending.storeNonatomic(1);
+    // The calling thread is worker 0, so it owns the deque the root goes into.
+    m_workers[0]->deque.push(&root);
+    m_dispatcher.kick(&TaskScheduler::workerRun, *this);
+}
+
+void TaskScheduler::workerRun(ureg index) {
+    Worker* worker = m_workers[index];
+    s_worker = worker;
+    AdaptiveBackoff backoff;
+    while (!m_done.load(turf::Acquire)) {
+        if (runOne(worker))
+            backoff.reset();
+        else
+            backoff.wait();
+    }
+    s_worker = NULL;
+}
+
+bool TaskScheduler::runOne(Worker* worker) {
+    Task* task = worker->deque.pop();
+    if (!task)
+        task = steal(worker);
+    if (!task)
+        return false;
+    task->execute();
+    finish(task);
+    return true;
+}
+
+Task* TaskScheduler::steal(Worker* worker) {
+    if (m_numWorkers <= 1)
+        return NULL;
+    // xorshift64
+    worker->random ^= worker->random << 13;
+    worker->random ^= worker->random >> 7;
+    worker->random ^= worker->random << 17;
+    ureg start = (ureg) (worker->random % m_numWorkers);
+    for (ureg i = 0; i < m_numWorkers; i++) {
+        Worker* victim = m_workers[(start + i) % m_numWorkers];
+        if (victim == worker)
+            continue;
+        Task* task = victim->deque.steal();
+        if (task)
+            return task;
+    }
+    return NULL;
+}
+
+void TaskScheduler::finish(Task* task) {
+    // Complete the task, then each ancestor whose last incomplete child it was.
+    while (task->m_pending.fetchSub(1, turf::AcquireRelease) == 1) {
+        Task* parent = task->m_parent;
+        task->onComplete();
+        if (!parent) {
+            m_done.store(1, turf::Release);
+            break;
+        }
+        task = parent;
+    }
+}
+
+} // namespace extra
+} // namespace turf
@@ -0,0 +1,115 @@
+/*------------------------------------------------------------------------
+  Turf: Configurable C++ platform adapter
+  Copyright (c) 2016 Jeff Preshing
+
+  Distributed under the Simplified BSD License.
+  Original location: https://github.com/preshing/turf
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the LICENSE file for more information.
+------------------------------------------------------------------------*/
+
+#ifndef TURF_EXTRA_TASKSCHEDULER_H
+#define TURF_EXTRA_TASKSCHEDULER_H
+
+#include <turf/Core.h>
+#include <turf/Atomic.h>
+#include <turf/Util.h>
+#include <turf/extra/JobDispatcher.h>
+#include <turf/extra/WorkStealingDeque.h>
+#include <vector>
+
+namespace turf {
+namespace extra {
+
+class TaskScheduler;
+
+//---------------------------------------------------------
+// Task
+// A unit of work run by TaskScheduler. Override execute(). Inside execute(), a task may spawn() child tasks,
+// which idle workers steal, and sync() to wait for them. While waiting, sync() runs other tasks instead of
+// blocking.
+//
+// A task is complete once it has returned from execute() and all of its children are complete. If execute()
+// returns without calling sync(), the task's completion waits for its children, and onComplete() runs on the
+// thread that finishes the last one. Use it as the parent's continuation, for example to combine the children's
+// results without keeping a worker blocked in sync().
+//
+// Tasks are owned by the caller. The scheduler doesn't touch a task after its onComplete(), so onComplete()
+// may delete it.
+//---------------------------------------------------------
+class Task {
+private:
+    friend class TaskScheduler;
+    Task* m_parent;
+    Atomic<sreg> m_pending; // Incomplete children, plus one until the task returns from execute()
+
+    // Not copyable
+    Task(const Task&);
+    Task& operator=(const Task&);
+
+public:
+    Task() : m_parent(NULL), m_pending(0) {
+    }
+    virtual ~Task() {
+    }
+
+    virtual void execute() = 0;
+    virtual void onComplete() {
+    }
+
+    // Must be called from this task's execute().
+    void spawn(Task& child);
+    void sync();
+};
+
+//---------------------------------------------------------
+// TaskScheduler
+// Runs a tree of Tasks on the threads of a JobDispatcher, including the calling thread. Each thread owns a
+// WorkStealingDeque: spawned tasks are pushed onto the spawning thread's deque and popped in LIFO order, and
+// threads that run out of work steal the oldest tasks from random victims. Threads are pinned by the
+// JobDispatcher, which, when default-constructed, pins one thread to each physical core using turf::Affinity.
+//---------------------------------------------------------
+class TaskScheduler {
+private:
+    friend class Task;
+
+    struct Worker {
+        TaskScheduler* scheduler;
+        WorkStealingDeque<Task> deque;
+        u64 random; // For choosing victims
+
+        Worker(TaskScheduler* scheduler, ureg index) : scheduler(scheduler), random(util::avalanche(u64(index) + 1)) {
+        }
+    };
+
+    JobDispatcher& m_dispatcher;
+    std::vector<Worker*> m_workers;
+    ureg m_numWorkers; // Workers taking part in the current run()
+    Atomic<u32> m_done;
+
+    static TURF_THREAD_LOCAL Worker* s_worker;
+
+    void workerRun(ureg index);
+    bool runOne(Worker* worker);
+    Task* steal(Worker* worker);
+    void finish(Task* task);
+
+    // Not copyable
+    TaskScheduler(const TaskScheduler&);
+    TaskScheduler& operator=(const TaskScheduler&);
+
+public:
+    TaskScheduler(JobDispatcher& dispatcher);
+    ~TaskScheduler();
+
+    // Runs root and everything it spawns, and returns once root is complete. Must be called from the thread that
+    // owns the JobDispatcher, and not from inside a task.
+    void run(Task& root);
+};
+
+} // namespace extra
+} // namespace turf
+
+#endif // TURF_EXTRA_TASKSCHEDULER_H
@@ -0,0 +1,143 @@
+/*------------------------------------------------------------------------
+  Turf: Configurable C++ platform adapter
+  Copyright (c) 2016 Jeff Preshing
+
+  Distributed under the Simplified BSD License.
+  Original location: https://github.com/preshing/turf
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the LICENSE file for more information.
+------------------------------------------------------------------------*/
+
+#ifndef TURF_EXTRA_WORKSTEALINGDEQUE_H
+#define TURF_EXTRA_WORKSTEALINGDEQUE_H
+
+#include <turf/Core.h>
+#include <turf/Assert.h>
+#include <turf/Atomic.h>
+#include <turf/Heap.h>
+
+namespace turf {
+namespace extra {
+
+//---------------------------------------------------------
+// WorkStealingDeque
+// The Chase-Lev deque, with the memory orders from Le et al., "Correct and Efficient Work-Stealing for Weak
+// Memory Models" (PPoPP 2013). The owning thread pushes and pops pointers at the bottom; any other thread may
+// steal from the top. Grows as needed. Old buffers are kept until the deque is destroyed, since a thief may
+// still be reading one.
+//---------------------------------------------------------
+template <typename T>
+class WorkStealingDeque {
+private:
+    struct Buffer {
+        sreg mask;
+        Buffer* prev;
+        Atomic<T*> items[1];
+
+        T* get(sreg index) {
+            return items[index & mask].load(turf::Relaxed);
+        }
+        void put(sreg index, T* item) {
+            items[index & mask].store(item, turf::Relaxed);
+        }
+    };
+
+    Atomic<sreg> m_top;
+    u8 padding[TURF_CACHE_LINE_SIZE - sizeof(Atomic<sreg>)]; // Thieves write m_top; only the owner writes m_bottom
+    Atomic<sreg> m_bottom;
+    Atomic<Buffer*> m_buffer;
+
+    static Buffer* createBuffer(sreg size, Buffer* prev) {
+        Buffer* buffer = (Buffer*) TURF_HEAP.alloc(sizeof(Buffer) + (size - 1) * sizeof(Atomic<T*>));
+        buffer->mask = size - 1;
+        buffer->prev = prev;
+        return buffer;
+    }
+
+    TURF_NO_INLINE Buffer* grow(Buffer* buffer, sreg top, sreg bottom) {
+        Buffer* newBuffer = createBuffer((buffer->mask + 1) * 2, buffer);
+        for (sreg i = top; i < bottom; i++)
+            newBuffer->put(i, buffer->get(i));
+        m_buffer.store(newBuffer, turf::Release);
+        return newBuffer;
+    }
+
+    // Not copyable
+    WorkStealingDeque(const WorkStealingDeque&);
+    WorkStealingDeque& operator=(const WorkStealingDeque&);
+
+public:
+    WorkStealingDeque(ureg initialSize = 256) : m_top(0), m_bottom(0) {
+        TURF_ASSERT((initialSize & (initialSize - 1)) == 0);
+        m_buffer.storeNonatomic(createBuffer(initialSize, NULL));
+    }
+
+    ~WorkStealingDeque() {
+        Buffer* buffer = m_buffer.loadNonatomic();
+        while (buffer) {
+            Buffer* prev = buffer->prev;
+            TURF_HEAP.free(buffer);
+            buffer = prev;
+        }
+    }
+
+    // Owner only.
+    void push(T* item) {
+        sreg bottom = m_bottom.load(turf::Relaxed);
+        sreg top = m_top.load(turf::Acquire);
+        Buffer* buffer = m_buffer.load(turf::Relaxed);
+        if (bottom - top > buffer->mask)
+            buffer = grow(buffer, top, bottom);
+        buffer->put(bottom, item);
+        m_bottom.store(bottom + 1, turf::Release); // Publishes the item to thieves
+    }
+
+    // Owner only. Returns the most recently pushed item, or NULL if empty.
+    T* pop() {
+        sreg bottom = m_bottom.load(turf::Relaxed) - 1;
+        Buffer* buffer = m_buffer.load(turf::Relaxed);
+        // Every store to m_bottom is a release, so that a thief that reads any of them sees the items pushed before.
+        m_bottom.store(bottom, turf::Release);
+        turf::threadFenceSeqCst();
+        sreg top = m_top.load(turf::Relaxed);
+        if (top > bottom) {
+            // Empty.
+            m_bottom.store(bottom + 1, turf::Release);
+            return NULL;
+        }
+        T* item = buffer->get(bottom);
+        if (top == bottom) {
+            // Last item. Race thieves for it.
+            if (!m_top.compareExchangeStrong(top, top + 1, turf::AcquireRelease))
+                item = NULL;
+            m_bottom.store(bottom + 1, turf::Release);
+        }
+        return item;
+    }
+
+    // Any thread. Returns the least recently pushed item, or NULL if empty or another thread won the race for it.
+    T* steal() {
+        sreg top = m_top.load(turf::Acquire);
+        turf::threadFenceSeqCst();
+        sreg bottom = m_bottom.load(turf::Acquire);
+        if (top >= bottom)
+            return NULL;
+        Buffer* buffer = m_buffer.load(turf::Acquire);
+        T* item = buffer->get(top);
+        if (!m_top.compareExchangeStrong(top, top + 1, turf::AcquireRelease))
+            return NULL;
+        return item;
+    }
+
+    // Approximate when called by a thief.
+    bool isEmpty() const {
+        return m_bottom.load(turf::Relaxed) <= m_top.load(turf::Relaxed);
+    }
+};
+
+} // namespace extra
+} // namespace turf
+
+#endif // TURF_EXTRA_WORKSTEALINGDEQUE_H
@@ -48,6 +48,24 @@ public:
         return m_coreIndexToInfo[core].hwThreadIndexToLogicalProcessor.size();
     }
 
+    u32 getNumNumaNodes() const {
+        return 1;
+    }
+
+    s32 getNumaNode(ureg core) const {
+        TURF_UNUSED(core);
+        return -1;
+    }
+
+    u32 getNumCacheDomains() const {
+        return 1;
+    }
+
+    u32 getCacheDomain(ureg core) const {
+        TURF_UNUSED(core);
+        return 0;
+    }
+
     bool setAffinity(ureg core, ureg hwThread);
 };
 
@@ -15,16 +15,130 @@
 #if TURF_KERNEL_LINUX
 
 #include <turf/impl/Affinity_Linux.h>
+#include <turf/Util.h>
 #include <string>
+#include <set>
 #include <fstream>
 #include <stdio.h>
+#include <stdlib.h>
+#include <dirent.h>
 
 namespace turf {
 
-Affinity_Linux::Affinity_Linux() : m_isAccurate(false), m_numHWThreads(0) {
+namespace {
+
+// Reads the first line of a small file, such as a sysfs attribute.
+bool readLine(const char* path, std::string& line) {
+    std::ifstream f(path);
+    if (!f.is_open())
+        return false;
+    std::getline(f, line);
+    return !f.fail();
+}
+
+u32 lowest(const std::vector<u32>& values, u32 fallback) {
+    u32 result = fallback;
+    for (ureg i = 0; i < values.size(); i++)
+        result = util::min(result, values[i]);
+    return result;
+}
+
+// The processors the process may run on, as seen by the first Affinity_Linux to be constructed. Later ones reuse it,
+// since by then the constructing thread may have been pinned to a single processor, for example by a JobDispatcher.
+struct AllowedProcessors {
+    cpu_set_t set;
+
+    AllowedProcessors() {
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) != 0 || CPU_COUNT(&set) == 0) {
+            // Can't tell, so assume every processor is allowed.
+            for (u32 cpu = 0; cpu < CPU_SETSIZE; cpu++)
+                CPU_SET(cpu, &set);
+        }
+    }
+};
+
+const cpu_set_t& getAllowedProcessors() {
+    static AllowedProcessors allowed;
+    return allowed.set;
+}
+
+} // anonymous namespace
+
+void Affinity_Linux::parseCPUList(const std::string& list, std::vector<u32>& values) {
+    const char* p = list.c_str();
+    for (;;) {
+        unsigned first, last;
+        int n;
+        if (sscanf(p, "%u%n", &first, &n) < 1)
+            break;
+        p += n;
+        last = first;
+        if (*p == '-') {
+            if (sscanf(p + 1, "%u%n", &last, &n) < 1)
+                break;
+            p += 1 + n;
+        }
+        for (unsigned v = first; v <= last; v++)
+            values.push_back(v);
+        if (*p != ',')
+            break;
+        p++;
+    }
+}
+
+Affinity_Linux::Affinity_Linux() : m_isAccurate(false), m_numHWThreads(0), m_numNumaNodes(1), m_numCacheDomains(1) {
+    const cpu_set_t& allowed = getAllowedProcessors();
+    if (!readSysfsTopology(allowed))
+        readCPUInfo(allowed);
+    m_isAccurate = (m_numHWThreads > 0);
+    if (m_isAccurate) {
+        readNumaNodes();
+        readCacheDomains();
+    } else {
+        m_coreIndexToInfo.resize(1);
+        m_coreIndexToInfo[0].hwThreadIndexToLogicalProcessor.push_back(0);
+        m_numHWThreads = 1;
+    }
+}
+
+bool Affinity_Linux::readSysfsTopology(const cpu_set_t& allowed) {
+    // Logical processors in the same core list the same siblings. Identify each core by its lowest sibling.
+    std::map<u32, u32> firstSiblingToCoreIndex;
+    char path[128];
+    for (u32 cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &allowed))
+            continue;
+        std::string line;
+        sprintf(path, "/sys/devices/system/cpu/cpu%u/topology/core_cpus_list", cpu);
+        if (!readLine(path, line)) {
+            // Kernels before 5.7 only have the older name.
+            sprintf(path, "/sys/devices/system/cpu/cpu%u/topology/thread_siblings_list", cpu);
+            if (!readLine(path, line))
+                continue; // Offline or not present
+        }
+        std::vector<u32> siblings;
+        parseCPUList(line, siblings);
+        u32 firstSibling = lowest(siblings, cpu);
+        std::map<u32, u32>::iterator iter = firstSiblingToCoreIndex.find(firstSibling);
+        u32 coreIndex;
+        if (iter == firstSiblingToCoreIndex.end()) {
+            coreIndex = (u32) m_coreIndexToInfo.size();
+            m_coreIndexToInfo.resize(coreIndex + 1);
+            firstSiblingToCoreIndex[firstSibling] = coreIndex;
+        } else {
+            coreIndex = iter->second;
+        }
+        m_coreIndexToInfo[coreIndex].hwThreadIndexToLogicalProcessor.push_back(cpu);
+        m_numHWThreads++;
+    }
+    return m_numHWThreads > 0;
+}
+
+void Affinity_Linux::readCPUInfo(const cpu_set_t& allowed) {
     std::ifstream f("/proc/cpuinfo");
     if (f.is_open()) {
-        CoreInfoCollector collector;
+        CoreInfoCollector collector(allowed);
         while (!f.eof()) {
             std::string line;
             std::getline(f, line);
@@ -46,12 +160,77 @@ Affinity_Linux::Affinity_Linux() : m_isAccurate(false), m_numHWThreads(0) {
         }
         collector.flush(*this);
     }
-    m_isAccurate = (m_numHWThreads > 0);
-    if (!m_isAccurate) {
-        m_coreIndexToInfo.resize(1);
-        m_coreIndexToInfo[0].hwThreadIndexToLogicalProcessor.push_back(0);
-        m_numHWThreads = 1;
+}
+
+void Affinity_Linux::readNumaNodes() {
+    std::map<u32, s32> cpuToNode;
+    DIR* dir = opendir("/sys/devices/system/node");
+    if (dir) {
+        char path[128];
+        while (struct dirent* entry = readdir(dir)) {
+            unsigned node;
+            char extra;
+            if (sscanf(entry->d_name, "node%u%c", &node, &extra) != 1)
+                continue;
+            std::string line;
+            sprintf(path, "/sys/devices/system/node/node%u/cpulist", node);
+            if (!readLine(path, line))
+                continue;
+            std::vector<u32> cpus;
+            parseCPUList(line, cpus);
+            for (ureg i = 0; i < cpus.size(); i++)
+                cpuToNode[cpus[i]] = (s32) node;
+        }
+        closedir(dir);
+    }
+    std::set<s32> nodes;
+    for (ureg c = 0; c < m_coreIndexToInfo.size(); c++) {
+        CoreInfo& info = m_coreIndexToInfo[c];
+        std::map<u32, s32>::iterator iter = cpuToNode.find(info.hwThreadIndexToLogicalProcessor[0]);
+        if (iter != cpuToNode.end()) {
+            info.numaNode = iter->second;
+            nodes.insert(iter->second);
+        }
+    }
+    m_numNumaNodes = util::max<u32>((u32) nodes.size(), 1);
+}
+
+void Affinity_Linux::readCacheDomains() {
+    // Cores whose last-level caches list the same processors share it. Identify each domain by its lowest
+    // processor. Cores without cache information all go in one domain.
+    std::map<u32, u32> firstCPUToDomain;
+    char path[128];
+    for (ureg c = 0; c < m_coreIndexToInfo.size(); c++) {
+        CoreInfo& info = m_coreIndexToInfo[c];
+        u32 cpu = info.hwThreadIndexToLogicalProcessor[0];
+        s32 bestLevel = 0;
+        u32 firstCPU = ~u32(0);
+        for (u32 index = 0;; index++) {
+            std::string line;
+            sprintf(path, "/sys/devices/system/cpu/cpu%u/cache/index%u/level", cpu, index);
+            if (!readLine(path, line))
+                break;
+            s32 level = atoi(line.c_str());
+            sprintf(path, "/sys/devices/system/cpu/cpu%u/cache/index%u/type", cpu, index);
+            if (!readLine(path, line) || line == "Instruction" || level <= bestLevel)
+                continue;
+            sprintf(path, "/sys/devices/system/cpu/cpu%u/cache/index%u/shared_cpu_list", cpu, index);
+            if (!readLine(path, line))
+                continue;
+            std::vector<u32> sharing;
+            parseCPUList(line, sharing);
+            bestLevel = level;
+            firstCPU = lowest(sharing, cpu);
+        }
+        std::map<u32, u32>::iterator iter = firstCPUToDomain.find(firstCPU);
+        if (iter == firstCPUToDomain.end()) {
+            info.cacheDomain = (u32) firstCPUToDomain.size();
+            firstCPUToDomain[firstCPU] = info.cacheDomain;
+        } else {
+            info.cacheDomain = iter->second;
+        }
     }
+    m_numCacheDomains = (u32) firstCPUToDomain.size();
 }
 
 bool Affinity_Linux::setAffinity(ureg core, ureg hwThread) {
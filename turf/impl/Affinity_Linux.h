@@ -18,17 +18,35 @@
 #include <sched.h>
 #include <vector>
 #include <map>
+#include <string>
 
 namespace turf {
 
+//---------------------------------------------------------
+// Learns the topology from /sys/devices/system/cpu and /sys/devices/system/node, falling back to /proc/cpuinfo
+// when sysfs isn't mounted. Only logical processors in the sched_getaffinity mask are counted, so inside a
+// container or cpuset, cores the process can't run on are left out. The mask is read once, when the first
+// Affinity_Linux is constructed, so that threads pinned since then don't hide the other cores.
+//---------------------------------------------------------
 class Affinity_Linux {
 private:
     struct CoreInfo {
         std::vector<u32> hwThreadIndexToLogicalProcessor;
+        s32 numaNode;    // -1 if unknown
+        u32 cacheDomain; // Index among the groups of cores sharing a last-level cache
+        CoreInfo() : numaNode(-1), cacheDomain(0) {
+        }
     };
     bool m_isAccurate;
     std::vector<CoreInfo> m_coreIndexToInfo;
     u32 m_numHWThreads;
+    u32 m_numNumaNodes;
+    u32 m_numCacheDomains;
+
+    bool readSysfsTopology(const cpu_set_t& allowed);
+    void readCPUInfo(const cpu_set_t& allowed);
+    void readNumaNodes();
+    void readCacheDomains();
 
     struct CoreInfoCollector {
         struct CoreID {
@@ -43,15 +61,16 @@ private:
             }
         };
 
+        const cpu_set_t& allowed;
         s32 logicalProcessor;
         CoreID coreID;
         std::map<CoreID, u32> coreIDToIndex;
 
-        CoreInfoCollector() : logicalProcessor(-1) {
+        CoreInfoCollector(const cpu_set_t& allowed) : allowed(allowed), logicalProcessor(-1) {
         }
 
         void flush(Affinity_Linux& affinity) {
-            if (logicalProcessor >= 0) {
+            if (logicalProcessor >= 0 && logicalProcessor < CPU_SETSIZE && CPU_ISSET(logicalProcessor, &allowed)) {
                 if (coreID.physical < 0 && coreID.core < 0) {
                     // On PowerPC Linux 3.2.0-4, /proc/cpuinfo outputs "processor", but not "physical id" or "core id".
                     // Emulate a single physical CPU with N cores:
@@ -94,7 +113,30 @@ public:
         return m_coreIndexToInfo[core].hwThreadIndexToLogicalProcessor.size();
     }
 
+    // Nodes with at least one core in getNumPhysicalCores().
+    u32 getNumNumaNodes() const {
+        return m_numNumaNodes;
+    }
+
+    // The kernel's node number, which can be passed to MemPage::alloc, or -1 if unknown.
+    s32 getNumaNode(ureg core) const {
+        return m_coreIndexToInfo[core].numaNode;
+    }
+
+    // Groups of cores that share a last-level cache.
+    u32 getNumCacheDomains() const {
+        return m_numCacheDomains;
+    }
+
+    // Returns a value less than getNumCacheDomains().
+    u32 getCacheDomain(ureg core) const {
+        return m_coreIndexToInfo[core].cacheDomain;
+    }
+
     bool setAffinity(ureg core, ureg hwThread);
+
+    // Appends the numbers in a sysfs list such as "0-3,8,10-11" to values.
+    static void parseCPUList(const std::string& list, std::vector<u32>& values);
 };
 
 } // namespace turf
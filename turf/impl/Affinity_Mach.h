@@ -70,6 +70,24 @@ public:
         return m_hwThreadsPerCore;
     }
 
+    u32 getNumNumaNodes() const {
+        return 1;
+    }
+
+    s32 getNumaNode(ureg core) const {
+        TURF_UNUSED(core);
+        return -1;
+    }
+
+    u32 getNumCacheDomains() const {
+        return 1;
+    }
+
+    u32 getCacheDomain(ureg core) const {
+        TURF_UNUSED(core);
+        return 0;
+    }
+
     bool setAffinity(ureg core, ureg hwThread) {
         TURF_ASSERT(core < m_numPhysicalCores);
         TURF_ASSERT(hwThread < m_hwThreadsPerCore);
@@ -37,6 +37,24 @@ public:
         return 1;
     }
 
+    u32 getNumNumaNodes() const {
+        return 1;
+    }
+
+    s32 getNumaNode(ureg core) const {
+        TURF_UNUSED(core);
+        return -1;
+    }
+
+    u32 getNumCacheDomains() const {
+        return 1;
+    }
+
+    u32 getCacheDomain(ureg core) const {
+        TURF_UNUSED(core);
+        return 0;
+    }
+
     bool setAffinity(ureg core, ureg hwThread) {
         TURF_UNUSED(core);
         TURF_UNUSED(hwThread);
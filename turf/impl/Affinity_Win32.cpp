@@ -23,8 +23,13 @@ Affinity_Win32::Affinity_Win32() {
     m_isAccurate = false;
     m_numPhysicalCores = 0;
     m_numHWThreads = 0;
-    for (ureg i = 0; i < MaxHWThreads; i++)
+    m_numNumaNodes = 0;
+    m_numCacheDomains = 0;
+    for (ureg i = 0; i < MaxHWThreads; i++) {
         m_physicalCoreMasks[i] = 0;
+        m_numaNodes[i] = -1;
+        m_cacheDomains[i] = 0;
+    }
 
     SYSTEM_LOGICAL_PROCESSOR_INFORMATION* startProcessorInfo = NULL;
     DWORD length = 0;
@@ -54,7 +59,38 @@ Affinity_Win32::Affinity_Win32() {
                     }
                 }
             }
+            // Match NUMA nodes and last-level data caches to the cores they contain.
+            u8 cacheLevels[MaxHWThreads] = {0};
+            AffinityMask cacheMasks[MaxHWThreads] = {0};
+            for (SYSTEM_LOGICAL_PROCESSOR_INFORMATION* processorInfo = startProcessorInfo; processorInfo < endProcessorInfo;
+                 processorInfo++) {
+                for (ureg core = 0; core < m_numPhysicalCores; core++) {
+                    if ((processorInfo->ProcessorMask & m_physicalCoreMasks[core]) == 0)
+                        continue;
+                    if (processorInfo->Relationship == RelationNumaNode) {
+                        m_numaNodes[core] = (s32) processorInfo->NumaNode.NodeNumber;
+                    } else if (processorInfo->Relationship == RelationCache &&
+                               processorInfo->Cache.Type != CacheInstruction &&
+                               processorInfo->Cache.Level > cacheLevels[core]) {
+                        cacheLevels[core] = processorInfo->Cache.Level;
+                        cacheMasks[core] = processorInfo->ProcessorMask;
+                    }
+                }
+            }
+            // Number the distinct nodes and caches. Cores without cache information all share one domain.
+            for (ureg core = 0; core < m_numPhysicalCores; core++) {
+                ureg other = 0;
+                while (other < core && cacheMasks[other] != cacheMasks[core])
+                    other++;
+                m_cacheDomains[core] = (other < core) ? m_cacheDomains[other] : m_numCacheDomains++;
+                other = 0;
+                while (other < core && m_numaNodes[other] != m_numaNodes[core])
+                    other++;
+                if (other == core && m_numaNodes[core] >= 0)
+                    m_numNumaNodes++;
+            }
         }
+        TURF_HEAP.free(startProcessorInfo);
     }
 
     TURF_ASSERT(m_numPhysicalCores <= m_numHWThreads);
@@ -64,6 +100,8 @@ Affinity_Win32::Affinity_Win32() {
         m_numHWThreads = 1;
         m_physicalCoreMasks[0] = 1;
     }
+    m_numNumaNodes = util::max<u32>(m_numNumaNodes, 1);
+    m_numCacheDomains = util::max<u32>(m_numCacheDomains, 1);
 }
 
 bool Affinity_Win32::setAffinity(ureg core, ureg hwThread) {
@@ -28,6 +28,10 @@ private:
     ureg m_numPhysicalCores;
     ureg m_numHWThreads;
     AffinityMask m_physicalCoreMasks[MaxHWThreads];
+    s32 m_numaNodes[MaxHWThreads];
+    u32 m_cacheDomains[MaxHWThreads];
+    u32 m_numNumaNodes;
+    u32 m_numCacheDomains;
 
 public:
     Affinity_Win32();
@@ -49,6 +53,24 @@ public:
         return static_cast<u32>(util::countSetBits(m_physicalCoreMasks[core]));
     }
 
+    u32 getNumNumaNodes() const {
+        return m_numNumaNodes;
+    }
+
+    s32 getNumaNode(ureg core) const {
+        TURF_ASSERT(core < m_numPhysicalCores);
+        return m_numaNodes[core];
+    }
+
+    u32 getNumCacheDomains() const {
+        return m_numCacheDomains;
+    }
+
+    u32 getCacheDomain(ureg core) const {
+        TURF_ASSERT(core < m_numPhysicalCores);
+        return m_cacheDomains[core];
+    }
+
     bool setAffinity(ureg core, ureg hwThread);
 };
 
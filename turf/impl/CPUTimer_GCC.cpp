@@ -0,0 +1,43 @@
+/*------------------------------------------------------------------------
+  Turf: Configurable C++ platform adapter
+  Copyright (c) 2016 Jeff Preshing
+
+  Distributed under the Simplified BSD License.
+  Original location: https://github.com/preshing/turf
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the LICENSE file for more information.
+------------------------------------------------------------------------*/
+
+#include <turf/Core.h>
+
+#if TURF_COMPILER_GCC && (TURF_CPU_X86 || TURF_CPU_X64)
+
+#include <turf/impl/CPUTimer_GCC.h>
+#include <chrono>
+
+namespace turf {
+
+// Counts timestamp counter ticks across a short interval of steady_clock time.
+static float measureTicksPerSecond() {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    CPUTimer_GCC::Point startTick = CPUTimer_GCC::get();
+    std::chrono::steady_clock::duration elapsed;
+    do {
+        elapsed = std::chrono::steady_clock::now() - start;
+    } while (elapsed < std::chrono::milliseconds(10));
+    CPUTimer_GCC::Point endTick = CPUTimer_GCC::get();
+    return (float) ((endTick - startTick) / std::chrono::duration<double>(elapsed).count());
+}
+
+CPUTimer_GCC::Converter::Converter() {
+    // Only calibrate once per process.
+    static float s_ticksPerSecond = measureTicksPerSecond();
+    ticksPerSecond = s_ticksPerSecond;
+    secondsPerTick = 1.f / s_ticksPerSecond;
+}
+
+} // namespace turf
+
+#endif // TURF_COMPILER_GCC && (TURF_CPU_X86 || TURF_CPU_X64)
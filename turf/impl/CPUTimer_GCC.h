@@ -13,6 +13,8 @@
 #ifndef TURF_IMPL_CPUTIMER_GCC_H
 #define TURF_IMPL_CPUTIMER_GCC_H
 
+#include <turf/Core.h>
+
 namespace turf {
 
 struct CPUTimer_GCC {
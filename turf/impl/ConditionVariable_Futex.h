@@ -0,0 +1,62 @@
+/*------------------------------------------------------------------------
+  Turf: Configurable C++ platform adapter
+  Copyright (c) 2016 Jeff Preshing
+
+  Distributed under the Simplified BSD License.
+  Original location: https://github.com/preshing/turf
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the LICENSE file for more information.
+------------------------------------------------------------------------*/
+
+#ifndef TURF_IMPL_CONDITIONVARIABLE_FUTEX_H
+#define TURF_IMPL_CONDITIONVARIABLE_FUTEX_H
+
+#include <turf/Core.h>
+#include <turf/impl/Mutex_Futex.h>
+#include <turf/impl/Futex_Linux.h>
+
+namespace turf {
+
+// Sequence-counter condition variable for use with Mutex_Futex.
+// Each wake bumps the sequence, so a waiter that reads it under the lock can't miss a wake
+// that happens between unlocking and sleeping. Spurious wakeups are possible, as usual.
+class ConditionVariable_Futex {
+private:
+    Atomic<u32> m_sequence;
+
+public:
+    ConditionVariable_Futex() : m_sequence(0) {
+    }
+
+    void wait(LockGuard<Mutex_Futex>& guard) {
+        u32 sequence = m_sequence.load(turf::Relaxed);
+        guard.getMutex().unlock();
+        Futex_Linux::wait(m_sequence, sequence);
+        guard.getMutex().lock();
+    }
+
+    void timedWait(LockGuard<Mutex_Futex>& guard, ureg waitMillis) {
+        if (waitMillis > 0) {
+            u32 sequence = m_sequence.load(turf::Relaxed);
+            guard.getMutex().unlock();
+            Futex_Linux::timedWait(m_sequence, sequence, waitMillis);
+            guard.getMutex().lock();
+        }
+    }
+
+    void wakeOne() {
+        m_sequence.fetchAdd(1, turf::Relaxed);
+        Futex_Linux::wake(m_sequence, 1);
+    }
+
+    void wakeAll() {
+        m_sequence.fetchAdd(1, turf::Relaxed);
+        Futex_Linux::wakeAll(m_sequence);
+    }
+};
+
+} // namespace turf
+
+#endif // TURF_IMPL_CONDITIONVARIABLE_FUTEX_H
@@ -0,0 +1,60 @@
+/*------------------------------------------------------------------------
+  Turf: Configurable C++ platform adapter
+  Copyright (c) 2016 Jeff Preshing
+
+  Distributed under the Simplified BSD License.
+  Original location: https://github.com/preshing/turf
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the LICENSE file for more information.
+------------------------------------------------------------------------*/
+
+#ifndef TURF_IMPL_FUTEX_LINUX_H
+#define TURF_IMPL_FUTEX_LINUX_H
+
+#include <turf/Core.h>
+#if !TURF_KERNEL_LINUX
+#error "Futexes are only available on Linux."
+#endif
+#include <turf/Atomic.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <limits.h>
+#include <time.h>
+
+namespace turf {
+
+// Thin wrapper around the futex syscall, operating on a 32-bit Turf atomic.
+// Process-private futexes only.
+struct Futex_Linux {
+    TURF_STATIC_ASSERT(sizeof(Atomic<u32>) == sizeof(u32));
+
+    // Blocks while word still holds expected. May return spuriously.
+    static void wait(Atomic<u32>& word, u32 expected) {
+        syscall(SYS_futex, (u32*) &word, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+    }
+
+    // Same as above, but gives up after waitMillis.
+    static void timedWait(Atomic<u32>& word, u32 expected, ureg waitMillis) {
+        struct timespec ts;
+        ts.tv_sec = waitMillis / 1000;
+        ts.tv_nsec = (waitMillis % 1000) * 1000000;
+        syscall(SYS_futex, (u32*) &word, FUTEX_WAIT_PRIVATE, expected, &ts, NULL, 0);
+    }
+
+    // Wakes up to count threads blocked in wait().
+    static void wake(Atomic<u32>& word, ureg count = 1) {
+        int n = (count > (ureg) INT_MAX) ? INT_MAX : (int) count;
+        syscall(SYS_futex, (u32*) &word, FUTEX_WAKE_PRIVATE, n, NULL, NULL, 0);
+    }
+
+    static void wakeAll(Atomic<u32>& word) {
+        syscall(SYS_futex, (u32*) &word, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+    }
+};
+
+} // namespace turf
+
+#endif // TURF_IMPL_FUTEX_LINUX_H
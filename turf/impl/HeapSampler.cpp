@@ -0,0 +1,261 @@
+/*------------------------------------------------------------------------
+  Turf: Configurable C++ platform adapter
+  Copyright (c) 2016 Jeff Preshing
+
+  Distributed under the Simplified BSD License.
+  Original location: https://github.com/preshing/turf
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the LICENSE file for more information.
+------------------------------------------------------------------------*/
+
+#include <turf/Core.h>
+
+#if TURF_DLMALLOC_SAMPLING
+
+#include <turf/impl/HeapSampler.h>
+#include <turf/MemPage.h>
+#include <turf/TID.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#if TURF_TARGET_WIN32
+#include <windows.h>
+#elif defined(__GLIBC__) || TURF_TARGET_APPLE
+#include <execinfo.h>
+#endif
+
+namespace turf {
+
+TURF_THREAD_LOCAL sreg HeapSampler::s_bytesUntilSample = 0;
+TURF_THREAD_LOCAL u64 HeapSampler::s_random = 0;
+
+static TURF_NO_INLINE ureg captureStack(void** stack, ureg maxDepth, ureg skip) {
+#if TURF_TARGET_WIN32
+    return CaptureStackBackTrace((DWORD) skip, (DWORD) maxDepth, stack, NULL);
+#elif defined(__GLIBC__) || TURF_TARGET_APPLE
+    void* frames[HeapSampler::MaxDepth + 4];
+    TURF_ASSERT(maxDepth + skip <= HeapSampler::MaxDepth + 4);
+    int depth = backtrace(frames, (int) (maxDepth + skip));
+    if (depth <= (int) skip)
+        return 0;
+    memcpy(stack, frames + skip, (depth - skip) * sizeof(void*));
+    return depth - skip;
+#else
+    TURF_UNUSED(stack);
+    TURF_UNUSED(maxDepth);
+    TURF_UNUSED(skip);
+    return 0;
+#endif
+}
+
+ureg HeapSampler::nextInterval() {
+    // Exponentially distributed gaps, so that samples aren't correlated with allocation patterns.
+    // xorshift64*
+    s_random ^= s_random >> 12;
+    s_random ^= s_random << 25;
+    s_random ^= s_random >> 27;
+    u64 r = s_random * 2685821657736338717ull;
+    double u = ((r >> 11) + 1) * (1.0 / 9007199254740992.0); // In (0, 1]
+    double interval = (double) getInterval();
+    return (ureg) util::min(-log(u) * interval, 1000.0 * interval) + 1;
+}
+
+HeapSampler::Table* HeapSampler::getTable() {
+    Table* table = m_table.load(turf::Acquire);
+    if (table)
+        return table;
+    // MemPage memory is already zeroed.
+    void* mem;
+    if (!MemPage::alloc(mem, sizeof(Table)))
+        return NULL;
+    if (m_table.compareExchangeStrong(table, (Table*) mem, turf::AcquireRelease))
+        return (Table*) mem;
+    MemPage::free(mem, sizeof(Table));
+    return table;
+}
+
+void HeapSampler::sample(void* ptr, ureg size, const char* site) {
+    if (s_random == 0) {
+        // This thread's first allocation. Start its countdown instead of sampling.
+        s_random = util::avalanche((u64) TID::getCurrentThreadID()) | 1;
+        s_bytesUntilSample = (sreg) nextInterval();
+        return;
+    }
+    if (getInterval() == 0) {
+        // Sampling is off. Check again later.
+        s_bytesUntilSample = (sreg) DefaultInterval;
+        return;
+    }
+    s_bytesUntilSample = (sreg) nextInterval();
+    if (!ptr)
+        return;
+    Table* table = getTable();
+    if (!table)
+        return;
+
+    u64 h = hash(ptr);
+    for (ureg i = 0; i < MaxProbes; i++) {
+        Slot& slot = table->slots[(h + i) & (NumSlots - 1)];
+        uptr key = slot.key.load(turf::Relaxed);
+        if ((key == Empty || key == Deleted) && slot.key.compareExchangeStrong(key, Claimed, turf::Acquire)) {
+            slot.size = size;
+            slot.site = site;
+            // Skip captureStack and this function, so the stack starts at the allocation.
+            slot.depth = captureStack(slot.stack, MaxDepth, 2);
+            table->filter[filterIndex(h)].fetchAdd(1, turf::Relaxed);
+            slot.key.store((uptr) ptr, turf::Release);
+            return;
+        }
+    }
+    table->numDropped.fetchAdd(1, turf::Relaxed);
+}
+
+void HeapSampler::remove(void* ptr) {
+    Table* table = m_table.loadNonatomic();
+    u64 h = hash(ptr);
+    for (ureg i = 0; i < MaxProbes; i++) {
+        Slot& slot = table->slots[(h + i) & (NumSlots - 1)];
+        uptr key = slot.key.load(turf::Relaxed);
+        if (key == (uptr) ptr) {
+            table->filter[filterIndex(h)].fetchSub(1, turf::Relaxed);
+            slot.key.store(Deleted, turf::Release);
+            return;
+        }
+        if (key == Empty)
+            return;
+    }
+}
+
+bool HeapSampler::dumpProfile(const char* path) {
+    FILE* f = fopen(path, "w");
+    if (!f)
+        return false;
+    Table* table = m_table.load(turf::Acquire);
+    ureg interval = getInterval();
+    if (interval == 0)
+        interval = DefaultInterval;
+
+    ureg totalCount = 0;
+    ureg totalBytes = 0;
+    if (table) {
+        for (ureg i = 0; i < NumSlots; i++) {
+            if (table->slots[i].key.load(turf::Acquire) > Claimed) {
+                totalCount++;
+                totalBytes += table->slots[i].size;
+            }
+        }
+    }
+    fprintf(f, "heap profile: %6" TURF_UREGD ": %8" TURF_UREGD " [%6" TURF_UREGD ": %8" TURF_UREGD "] @ heap_v2/%" TURF_UREGD
+               "\n",
+            totalCount, totalBytes, totalCount, totalBytes, interval);
+    if (table) {
+        for (ureg i = 0; i < NumSlots; i++) {
+            Slot& slot = table->slots[i];
+            uptr key = slot.key.load(turf::Acquire);
+            if (key <= Claimed)
+                continue;
+            ureg size = slot.size;
+            ureg depth = util::min<ureg>(slot.depth, MaxDepth);
+            void* stack[MaxDepth];
+            memcpy(stack, slot.stack, depth * sizeof(void*));
+            // Skip the sample if it was freed and the slot reused while we were copying it.
+            turf::threadFenceAcquire();
+            if (slot.key.load(turf::Relaxed) != key)
+                continue;
+            fprintf(f, "%6d: %8" TURF_UREGD " [%6d: %8" TURF_UREGD "] @", 1, size, 1, size);
+            for (ureg d = 0; d < depth; d++)
+                fprintf(f, " 0x%llx", (unsigned long long) (uptr) stack[d]);
+            fprintf(f, "\n");
+        }
+    }
+#if TURF_KERNEL_LINUX
+    // Lets pprof symbolize addresses in shared libraries and position-independent executables.
+    FILE* maps = fopen("/proc/self/maps", "r");
+    if (maps) {
+        fprintf(f, "\nMAPPED_LIBRARIES:\n");
+        char buf[4096];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), maps)) > 0)
+            fwrite(buf, 1, n, f);
+        fclose(maps);
+    }
+#endif
+    bool ok = !ferror(f);
+    if (fclose(f) != 0)
+        ok = false;
+    return ok;
+}
+
+namespace {
+struct SiteTotal {
+    const char* site;
+    double bytes;
+    double count;
+};
+
+int compareSite(const void* a, const void* b) {
+    uptr siteA = (uptr) ((const SiteTotal*) a)->site;
+    uptr siteB = (uptr) ((const SiteTotal*) b)->site;
+    return (siteA > siteB) - (siteA < siteB);
+}
+
+int compareBytes(const void* a, const void* b) {
+    double bytesA = ((const SiteTotal*) a)->bytes;
+    double bytesB = ((const SiteTotal*) b)->bytes;
+    return (bytesA < bytesB) - (bytesA > bytesB);
+}
+} // anonymous namespace
+
+void HeapSampler::dumpSites() {
+    Table* table = m_table.load(turf::Acquire);
+    if (!table)
+        return;
+    double interval = (double) getInterval();
+    if (interval == 0)
+        interval = (double) DefaultInterval;
+    // Scratch space comes from MemPage, since this may be dumping the only heap.
+    ureg scratchSize = sizeof(SiteTotal) * NumSlots;
+    void* mem;
+    if (!MemPage::alloc(mem, scratchSize))
+        return;
+    SiteTotal* totals = (SiteTotal*) mem;
+    ureg numTotals = 0;
+    for (ureg i = 0; i < NumSlots; i++) {
+        Slot& slot = table->slots[i];
+        if (slot.key.load(turf::Acquire) <= Claimed)
+            continue;
+        // A block of this size is sampled with probability 1 - e^(-size / interval). Weight it accordingly.
+        double size = (double) slot.size;
+        double weight = 1.0 / (1.0 - exp(-size / interval));
+        SiteTotal& total = totals[numTotals++];
+        total.site = slot.site;
+        total.bytes = size * weight;
+        total.count = weight;
+    }
+    // Merge the samples of each call site.
+    qsort(totals, numTotals, sizeof(SiteTotal), compareSite);
+    ureg numSites = 0;
+    for (ureg i = 0; i < numTotals; i++) {
+        if (numSites > 0 && totals[numSites - 1].site == totals[i].site) {
+            totals[numSites - 1].bytes += totals[i].bytes;
+            totals[numSites - 1].count += totals[i].count;
+        } else {
+            totals[numSites++] = totals[i];
+        }
+    }
+    qsort(totals, numSites, sizeof(SiteTotal), compareBytes);
+    printf("%14s %10s  %s\n", "est. bytes", "est. live", "site");
+    for (ureg i = 0; i < numSites; i++)
+        printf("%14.0f %10.0f  %s\n", totals[i].bytes, totals[i].count, totals[i].site ? totals[i].site : "(unknown)");
+    ureg numDropped = table->numDropped.load(turf::Relaxed);
+    if (numDropped > 0)
+        printf("%" TURF_UREGD " samples dropped because the table was full\n", numDropped);
+    MemPage::free(mem, scratchSize);
+}
+
+} // namespace turf
+
+#endif // TURF_DLMALLOC_SAMPLING
@@ -0,0 +1,124 @@
+/*------------------------------------------------------------------------
+  Turf: Configurable C++ platform adapter
+  Copyright (c) 2016 Jeff Preshing
+
+  Distributed under the Simplified BSD License.
+  Original location: https://github.com/preshing/turf
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the LICENSE file for more information.
+------------------------------------------------------------------------*/
+
+#ifndef TURF_IMPL_HEAPSAMPLER_H
+#define TURF_IMPL_HEAPSAMPLER_H
+
+#include <turf/Core.h>
+#include <turf/Atomic.h>
+#include <turf/Util.h>
+
+namespace turf {
+
+//---------------------------------------------------------
+// Samples about one allocation per sampling interval (512 KB by default), and records its size,
+// call site and backtrace until it's freed. Used by Heap_DL when TURF_DLMALLOC_SAMPLING is enabled.
+// Each thread counts down the bytes it allocates, so allocations that aren't sampled only pay for a
+// thread-local subtraction, and frees of unsampled blocks only pay for one load from a small filter.
+// Samples are kept in a lock-free table, which is allocated when the first sample is taken.
+// Works when zero-init at global scope.
+//---------------------------------------------------------
+class HeapSampler {
+public:
+    static const ureg DefaultInterval = 512 * 1024;
+    static const ureg MaxDepth = 32;
+
+private:
+    static const ureg NumSlots = 1 << 15;   // Maximum number of live samples
+    static const ureg FilterSize = 1 << 15;
+    static const ureg MaxProbes = 64;
+
+    // Values of Slot::key that aren't block addresses.
+    static const uptr Empty = 0;
+    static const uptr Deleted = 1;
+    static const uptr Claimed = 2; // Being filled in by the thread that claimed it
+
+    struct Slot {
+        Atomic<uptr> key;
+        ureg size;
+        const char* site;
+        ureg depth;
+        void* stack[MaxDepth];
+    };
+
+    struct Table {
+        // Counts the live samples whose address hashes to each entry. A free only looks in slots[]
+        // when its entry is nonzero.
+        Atomic<u16> filter[FilterSize];
+        Atomic<ureg> numDropped; // Samples that didn't fit in the table
+        Slot slots[NumSlots];
+    };
+
+    Atomic<Table*> m_table;
+    Atomic<ureg> m_interval; // Zero means DefaultInterval; Disabled turns sampling off
+
+    static const ureg Disabled = ~ureg(0);
+
+    static TURF_THREAD_LOCAL sreg s_bytesUntilSample;
+    static TURF_THREAD_LOCAL u64 s_random; // Zero until the thread's first sampling decision
+
+    static u64 hash(void* ptr) {
+        return util::avalanche((u64) (uptr) ptr);
+    }
+
+    // Uses different bits of the hash than the slot index, so that a filter hit is independent of probe collisions.
+    static ureg filterIndex(u64 hash) {
+        return (ureg) (hash >> 40) & (FilterSize - 1);
+    }
+
+    TURF_NO_INLINE void sample(void* ptr, ureg size, const char* site);
+    TURF_NO_INLINE void remove(void* ptr);
+    Table* getTable();
+    ureg nextInterval();
+
+public:
+    // Must be called for every allocation. It's harmless to pass a NULL ptr.
+    void onAlloc(void* ptr, ureg size, const char* site) {
+        sreg remaining = s_bytesUntilSample - (sreg) size;
+        s_bytesUntilSample = remaining;
+        if (remaining < 0)
+            sample(ptr, size, site);
+    }
+
+    // Must be called for every block before it's freed. For a block that's reallocated, call it once the realloc
+    // has succeeded. If another thread is given the old address in between, a sample may be dropped, which only
+    // makes the profile slightly less complete.
+    void onFree(void* ptr) {
+        Table* table = m_table.load(turf::Acquire);
+        if (table && table->filter[filterIndex(hash(ptr))].load(turf::Relaxed) != 0)
+            remove(ptr);
+    }
+
+    // Sets the mean number of bytes between samples. Zero turns sampling off.
+    // Threads pick up the new interval after their next sample.
+    void setInterval(ureg interval) {
+        m_interval.store(interval ? interval : Disabled, turf::Relaxed);
+    }
+
+    ureg getInterval() const {
+        ureg interval = m_interval.load(turf::Relaxed);
+        return interval == 0 ? DefaultInterval : interval == Disabled ? 0 : interval;
+    }
+
+    // Writes the live samples as a heap profile in the legacy gperftools format, which pprof reads.
+    // pprof scales the samples by the interval to estimate the true totals.
+    // Samples taken or freed during the dump may be missed or partially read.
+    // Returns false if the file couldn't be opened or written.
+    bool dumpProfile(const char* path);
+
+    // Prints the estimated live bytes of each call site to stdout, largest first.
+    void dumpSites();
+};
+
+} // namespace turf
+
+#endif // TURF_IMPL_HEAPSAMPLER_H
@@ -33,6 +33,23 @@ public:
         void free(void* ptr) {
             ::free(ptr);
         }
+
+        // Same interface as Heap_DL::Operator, but the CRT has no batch functions, so these just loop.
+        bool allocBatch(ureg size, ureg count, void** out) {
+            for (ureg i = 0; i < count; i++) {
+                out[i] = ::malloc((size_t) size);
+                if (!out[i]) {
+                    freeBatch(out, i);
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        void freeBatch(void** ptrs, ureg count) {
+            for (ureg i = 0; i < count; i++)
+                ::free(ptrs[i]);
+        }
     };
 
     Operator operate(const char*) {
@@ -22,10 +22,14 @@
 #include <turf/impl/Mutex_LazyInit.h>
 #include <turf/Assert.h>
 #include <stdlib.h>
+#include <stdio.h>
 #include <memory.h>
 // FIXME: Define a configurable strategy for failed platform calls in Turf, and
 // make MALLOC_FAILURE_ACTION follow it.
 #include <errno.h>
+#if TURF_DLMALLOC_THREAD_CACHE && !TURF_TARGET_WIN32
+#include <pthread.h>
+#endif
 
 // clang-format off
 
@@ -39,6 +43,7 @@
 #define MALLOC_ALIGNMENT ((size_t)(2 * sizeof(void *)))
 #endif  /* MALLOC_ALIGNMENT */
 #ifndef FOOTERS
+#define FOOTERS (TURF_DLMALLOC_NUM_ARENAS > 1) /* Lets dlmalloc_owner() find a chunk's arena */
 #endif  /* FOOTERS */
 #ifndef ABORT
 #define ABORT  abort()
@@ -805,6 +810,12 @@ static struct malloc_params mparams;
 
 #define is_initialized(M)  ((M)->top != 0)
 
+/* The footprint only changes under the arena's lock, but Heap_DL reads it
+   without locking, so it's stored atomically. */
+#define get_footprint(M)     ((size_t)(M)->footprint.load(turf::Relaxed))
+#define add_footprint(M, S)  ((M)->footprint.store((ureg)(get_footprint(M) + (S)), turf::Relaxed))
+#define sub_footprint(M, S)  ((M)->footprint.store((ureg)(get_footprint(M) - (S)), turf::Relaxed))
+
 /* -------------------------- system alloc setup ------------------------- */
 
 /* Operations on mflags */
@@ -1321,7 +1332,7 @@ static void do_check_any_chunk(mstate m, mchunkptr p) {
 /* Check properties of top chunk */
 static void do_check_top_chunk(mstate m, mchunkptr p) {
   msegmentptr sp = segment_holding(m, (char*)p);
-  size_t  sz = p->head & ~INUSE_BITS; /* third-lowest bit can be set! */
+  size_t  sz = chunksize(p); /* third-lowest bit can be set! */
   assert(sp != 0);
   assert((is_aligned(chunk2mem(p))) || (p->head == FENCEPOST_HEAD));
   assert(ok_address(m, p));
@@ -1573,8 +1584,8 @@ static void do_check_malloc_state(mstate m) {
   }
 
   total = traverse_and_check(m);
-  assert(total <= m->footprint);
-  assert(m->footprint <= m->max_footprint);
+  assert(total <= get_footprint(m));
+  assert(get_footprint(m) <= m->max_footprint);
 }
 #endif /* TURF_DLMALLOC_DEBUG_CHECKS */
 
@@ -1591,7 +1602,7 @@ static void internal_malloc_stats(mstate m, Stats& stats) {
     if (is_initialized(m)) {
       msegmentptr s = &m->seg;
       maxfp = m->max_footprint;
-      fp = m->footprint;
+      fp = get_footprint(m);
       // Refined stats:
       // Unlike DLMalloc's original stats, this doesn't count malloc_segments or fenceposts as allocated chunks.
       while (s != 0) {
@@ -1871,8 +1882,8 @@ static void internal_malloc_stats(mstate m, Stats& stats) {
 static void* mmap_alloc(mstate m, size_t nb) {
   size_t mmsize = mmap_align(nb + SIX_SIZE_T_SIZES + CHUNK_ALIGN_MASK);
   if (m->footprint_limit != 0) {
-    size_t fp = m->footprint + mmsize;
-    if (fp <= m->footprint || fp > m->footprint_limit)
+    size_t fp = get_footprint(m) + mmsize;
+    if (fp <= get_footprint(m) || fp > m->footprint_limit)
       return 0;
   }
   if (mmsize > nb) {     /* Check for wrap around 0 */
@@ -1889,8 +1900,9 @@ static void* mmap_alloc(mstate m, size_t nb) {
 
       if (m->least_addr == 0 || mm < m->least_addr)
         m->least_addr = mm;
-      if ((m->footprint += mmsize) > m->max_footprint)
-        m->max_footprint = m->footprint;
+      add_footprint(m, mmsize);
+      if (get_footprint(m) > m->max_footprint)
+        m->max_footprint = get_footprint(m);
       assert(is_aligned(chunk2mem(p)));
       check_mmapped_chunk(m, p);
       return chunk2mem(p);
@@ -1925,8 +1937,9 @@ static mchunkptr mmap_resize(mstate m, mchunkptr oldp, size_t nb, int flags) {
 
       if (cp < m->least_addr)
         m->least_addr = cp;
-      if ((m->footprint += newmmsize - oldmmsize) > m->max_footprint)
-        m->max_footprint = m->footprint;
+      add_footprint(m, newmmsize - oldmmsize);
+      if (get_footprint(m) > m->max_footprint)
+        m->max_footprint = get_footprint(m);
       check_mmapped_chunk(m, newp);
       return newp;
     }
@@ -2098,8 +2111,8 @@ static void* sys_alloc(mstate m, size_t nb) {
   if (asize <= nb)
     return 0; /* wraparound */
   if (m->footprint_limit != 0) {
-    size_t fp = m->footprint + asize;
-    if (fp <= m->footprint || fp > m->footprint_limit)
+    size_t fp = get_footprint(m) + asize;
+    if (fp <= get_footprint(m) || fp > m->footprint_limit)
       return 0;
   }
 
@@ -2138,10 +2151,10 @@ static void* sys_alloc(mstate m, size_t nb) {
         /* Adjust to end on a page boundary */
         if (!is_page_aligned(base))
           ssize += (page_align((size_t)base) - (size_t)base);
-        fp = m->footprint + ssize; /* recheck limits */
+        fp = get_footprint(m) + ssize; /* recheck limits */
         if (ssize > nb && ssize < HALF_MAX_SIZE_T &&
             (m->footprint_limit == 0 ||
-             (fp > m->footprint && fp <= m->footprint_limit)) &&
+             (fp > get_footprint(m) && fp <= m->footprint_limit)) &&
             (br = (char*)(CALL_MORECORE(ssize))) == base) {
           tbase = base;
           tsize = ssize;
@@ -2215,8 +2228,9 @@ static void* sys_alloc(mstate m, size_t nb) {
 
   if (tbase != CMFAIL) {
 
-    if ((m->footprint += tsize) > m->max_footprint)
-      m->max_footprint = m->footprint;
+    add_footprint(m, tsize);
+    if (get_footprint(m) > m->max_footprint)
+      m->max_footprint = get_footprint(m);
 
     if (!is_initialized(m)) { /* first-time initialization */
       if (m->least_addr == 0 || tbase < m->least_addr)
@@ -2307,7 +2321,7 @@ static size_t release_unused_segments(mstate m) {
         }
         if (CALL_MUNMAP(base, size) == 0) {
           released += size;
-          m->footprint -= size;
+          sub_footprint(m, size);
           /* unlink obsoleted record */
           sp = pred;
           sp->next = next;
@@ -2375,7 +2389,7 @@ static int sys_trim(mstate m, size_t pad) {
 
       if (released != 0) {
         sp->size -= released;
-        m->footprint -= released;
+        sub_footprint(m, released);
         init_top(m, m->top, m->topsize - released);
         check_top_chunk(m, m->top);
       }
@@ -2393,6 +2407,54 @@ static int sys_trim(mstate m, size_t pad) {
   return (released != 0)? 1 : 0;
 }
 
+/* Return the whole pages inside a free chunk to the OS, keeping its header
+   and the next chunk's prev_foot. MemPage::purge frees the memory
+   immediately, unlike MemPage::discard, and the pages read as zero
+   afterwards. The chunk is marked with FLAG4_BIT so that later calls skip
+   it; the bit is lost whenever the chunk is split, merged or allocated,
+   since those rewrite its head. */
+static size_t release_chunk_pages(mchunkptr p) {
+  size_t psize = chunksize(p);
+  char* start = (char*)page_align((size_t)p + sizeof(tchunk));
+  char* end = (char*)(((size_t)p + psize) & ~(mparams.page_size - SIZE_T_ONE));
+  if (flag4inuse(p) || end <= start)
+    return 0;
+  if (!turf::MemPage::purge(start, end - start))
+    return 0;
+  set_flag4(p);
+  return end - start;
+}
+
+static size_t release_tree_pages(tchunkptr t) {
+  size_t released = 0;
+  while (t != 0) {
+    tchunkptr u = t;
+    do { /* chunks of the same size hang off the tree node */
+      released += release_chunk_pages((mchunkptr)u);
+      u = u->fd;
+    } while (u != t);
+    if (t->child[0] != 0)
+      released += release_tree_pages(t->child[0]);
+    t = t->child[1];
+  }
+  return released;
+}
+
+/* Discard the pages of free chunks that sys_trim can't unmap because live
+   chunks share their segment. Small chunks never span a page. */
+static size_t release_free_pages(mstate m) {
+  size_t released = 0;
+  bindex_t i;
+  if (is_initialized(m)) {
+    for (i = 0; i < NTREEBINS; ++i)
+      released += release_tree_pages(*treebin_at(m, i));
+    if (m->dv != 0)
+      released += release_chunk_pages(m->dv);
+    released += release_chunk_pages(m->top);
+  }
+  return released;
+}
+
 /* Consolidate and bin a chunk. Differs from exported versions
    of free mainly in that the chunk need not be marked as inuse.
 */
@@ -2404,7 +2466,7 @@ static void dispose_chunk(mstate m, mchunkptr p, size_t psize) {
     if (is_mmapped(p)) {
       psize += prevsize + MMAP_FOOT_PAD;
       if (CALL_MUNMAP((char*)p - prevsize, psize) == 0)
-        m->footprint -= psize;
+        sub_footprint(m, psize);
       return;
     }
     prev = chunk_minus_offset(p, prevsize);
@@ -2745,7 +2807,7 @@ void dlfree(void* mem, mstate gm) {
           if (is_mmapped(p)) {
             psize += prevsize + MMAP_FOOT_PAD;
             if (CALL_MUNMAP((char*)p - prevsize, psize) == 0)
-              fm->footprint -= psize;
+              sub_footprint(fm, psize);
             goto postaction;
           }
           else {
@@ -3156,8 +3218,12 @@ static size_t internal_bulk_free(mstate m, void* array[], size_t nelem) {
             set_inuse(m, p, newsize);
             *b = chunk2mem(p);
           }
-          else
+          else {
+#if TURF_DLMALLOC_FAST_STATS
+            m->inUseBytes -= psize;
+#endif
             dispose_chunk(m, p, psize);
+          }
         }
         else {
           CORRUPTION_ERROR_ACTION(m);
@@ -3302,6 +3368,12 @@ void** dlindependent_calloc(size_t n_elements, size_t elem_size,
   return ialloc(gm, n_elements, &sz, 3, chunks);
 }
 
+void** dlindependent_malloc(size_t n_elements, size_t elem_size,
+                            void* chunks[], mstate gm) {
+  size_t sz = elem_size; /* serves as 1-element array */
+  return ialloc(gm, n_elements, &sz, 1, chunks);
+}
+
 void** dlindependent_comalloc(size_t n_elements, size_t sizes[],
                               void* chunks[], mstate gm) {
   return ialloc(gm, n_elements, sizes, 0, chunks);
@@ -3321,8 +3393,18 @@ int dlmalloc_trim(size_t pad, mstate gm) {
   return result;
 }
 
+size_t dlmalloc_release_free_pages(mstate gm) {
+  size_t result = 0;
+  ensure_initialization();
+  if (!PREACTION(gm)) {
+    result = release_free_pages(gm);
+    POSTACTION(gm);
+  }
+  return result;
+}
+
 size_t dlmalloc_footprint(mstate gm) {
-  return gm->footprint;
+  return get_footprint(gm);
 }
 
 size_t dlmalloc_max_footprint(mstate gm) {
@@ -3360,7 +3442,360 @@ size_t dlmalloc_usable_size(void* mem) {
   return 0;
 }
 
+void dlmalloc_init() {
+  ensure_initialization();
+}
+
+mstate dlmalloc_owner(void* mem) {
+#if FOOTERS
+  /* The footer of an in-use chunk is only written when the chunk is allocated, so no lock is needed. */
+  mchunkptr p = mem2chunk(mem);
+  mstate m = get_mstate_for(p);
+  if (!ok_magic(m)) {
+    USAGE_ERROR_ACTION(m, p);
+    return 0;
+  }
+  return m;
+#else /* FOOTERS */
+  (void) mem;
+  return 0;
+#endif /* FOOTERS */
+}
+
 } // namespace memory_dl
+
+#if TURF_DLMALLOC_NUM_ARENAS > 1
+TURF_THREAD_LOCAL ureg Heap_DL::s_arenaSlot = 0;
+Atomic<ureg> Heap_DL::s_nextArenaSlot;
+Atomic<u32> Heap_DL::s_initialized;
+
+void Heap_DL::initialize() {
+    // mparams is shared by every arena, and chunk footers are tagged with its magic value, so it must be initialized
+    // exactly once, before any arena is used.
+    static Lock initMutex;
+    LockGuard<Lock> guard(initMutex);
+    memory_dl::dlmalloc_init();
+    s_initialized.store(1, turf::Release);
+}
+
+ureg Heap_DL::assignArenaSlot() {
+    ensureInitialized();
+    ureg slot = s_nextArenaSlot.fetchAdd(1, turf::Relaxed) + 1;
+    s_arenaSlot = slot;
+    return slot;
+}
+#endif
+
+
+void Heap_DL::freeBatch(void** ptrs, ureg count) {
+    // dlbulk_free clears the entries it frees, and leaves blocks owned by other arenas in place.
+    // Each pass frees every remaining block owned by the same arena as the first one.
+    for (ureg i = 0; i < count; i++) {
+        if (!ptrs[i])
+            continue;
+        Arena& arena = getOwner(ptrs[i]);
+        LockGuard<Lock> guard(arena.mutex);
+        memory_dl::dlbulk_free(ptrs + i, (size_t)(count - i), &arena.mstate);
+    }
+}
+
+#if TURF_DLMALLOC_SITE_STATS
+Heap_DL::Site* Heap_DL::getSiteSlow(const char* name) {
+    ensureInitialized();
+    ureg hash = hashSite(name);
+    Site* created = NULL;
+    Site* result = &m_overflowSite;
+    for (ureg i = 0; i < MaxSites; i++) {
+        Atomic<Site*>& slot = m_sites[(hash + i) & (MaxSites - 1)];
+        Site* site = slot.load(turf::Acquire);
+        if (!site) {
+            if (!created) {
+                LockGuard<Lock> guard(m_arenas[0].mutex);
+                created = (Site*) memory_dl::dlmemalign(TURF_CACHE_LINE_SIZE, sizeof(Site), &m_arenas[0].mstate);
+                if (!created)
+                    return &m_overflowSite;
+                for (ureg s = 0; s < Site::NumShards; s++) {
+                    Site::Shard& shard = created->shards[s];
+                    shard.liveBytes.storeNonatomic(0);
+                    shard.liveCount.storeNonatomic(0);
+                    shard.totalBytes.storeNonatomic(0);
+                    shard.totalCount.storeNonatomic(0);
+                }
+                created->name = name;
+            }
+            if (slot.compareExchangeStrong(site, created, turf::AcquireRelease))
+                return created;
+            // Another thread filled the slot first. Check whether it was for the same call site.
+        }
+        if (site->name == name) {
+            result = site;
+            break;
+        }
+    }
+    if (created) {
+        LockGuard<Lock> guard(m_arenas[0].mutex);
+        memory_dl::dlfree(created, &m_arenas[0].mstate);
+    }
+    return result;
+}
+
+void* Heap_DL::trackAligned(ureg size, ureg alignment, const char* name) {
+    if (alignment <= SiteHeaderSize)
+        return track(allocRaw(size + SiteHeaderSize), size, name);
+    // Put the header just below the aligned block, and the raw block pointer just below the header.
+    u8* raw = (u8*) allocAlignedRaw(size + alignment, alignment);
+    if (!raw)
+        return NULL;
+    void* result = track(raw + alignment - SiteHeaderSize, size, name);
+    SiteHeader* header = (SiteHeader*) result - 1;
+    header->site |= 1;
+    ((void**) header)[-1] = raw;
+    return result;
+}
+
+void* Heap_DL::trackRealloc(void* ptr, ureg newSize, const char* name) {
+    if (!ptr)
+        return track(allocRaw(newSize + SiteHeaderSize), newSize, name);
+    SiteHeader* header = (SiteHeader*) ptr - 1;
+    if (header->site & 1) {
+        // Over-aligned blocks can't be resized in place, since the header isn't at the start of the raw block.
+        void* result = track(allocRaw(newSize + SiteHeaderSize), newSize, name);
+        if (result) {
+            memcpy(result, ptr, util::min(header->size, newSize));
+            freeRaw(untrack(ptr));
+        }
+        return result;
+    }
+    Site* oldSite = (Site*) header->site;
+    ureg oldSize = header->size;
+    void* raw = reallocRaw(header, newSize + SiteHeaderSize);
+    if (!raw)
+        return NULL;
+    Site::Shard& shard = getShard(oldSite);
+    shard.liveBytes.fetchSub(oldSize, turf::Relaxed);
+    shard.liveCount.fetchSub(1, turf::Relaxed);
+    return track(raw, newSize, name);
+}
+
+ureg Heap_DL::getSiteStats(SiteStats* out, ureg maxSites) {
+    ureg numSites = 0;
+    for (ureg i = 0; i <= MaxSites; i++) {
+        Site* site = (i < MaxSites) ? m_sites[i].load(turf::Acquire) : &m_overflowSite;
+        if (!site)
+            continue;
+        SiteStats stats = {site->name, 0, 0, 0, 0};
+        for (ureg s = 0; s < Site::NumShards; s++) {
+            Site::Shard& shard = site->shards[s];
+            stats.liveBytes += shard.liveBytes.load(turf::Relaxed);
+            stats.liveCount += shard.liveCount.load(turf::Relaxed);
+            stats.totalBytes += shard.totalBytes.load(turf::Relaxed);
+            stats.totalCount += shard.totalCount.load(turf::Relaxed);
+        }
+        if (site == &m_overflowSite && stats.totalCount == 0)
+            continue;
+        // Shards are read one at a time, so a concurrent free can be counted without its allocation.
+        if ((sreg) stats.liveBytes < 0 || (sreg) stats.liveCount < 0) {
+            stats.liveBytes = 0;
+            stats.liveCount = 0;
+        }
+        if (numSites < maxSites)
+            out[numSites] = stats;
+        numSites++;
+    }
+    return numSites;
+}
+
+Heap_DL::Stats Heap_DL::getApproxStats() {
+    Stats stats = {0, 0, 0};
+    // A racy read of max_footprint, which only changes under the arena locks. Good enough for monitoring.
+    for (ureg i = 0; i < NumArenas; i++) {
+        const volatile memory_dl::malloc_state& mstate = m_arenas[i].mstate;
+        stats.peakSystemBytes += mstate.max_footprint;
+        stats.systemBytes += m_arenas[i].mstate.footprint.load(turf::Relaxed);
+    }
+    sreg inUseBytes = 0;
+    for (ureg i = 0; i <= MaxSites; i++) {
+        Site* site = (i < MaxSites) ? m_sites[i].load(turf::Acquire) : &m_overflowSite;
+        if (site) {
+            for (ureg s = 0; s < Site::NumShards; s++)
+                inUseBytes += site->shards[s].liveBytes.load(turf::Relaxed);
+        }
+    }
+    stats.inUseBytes = util::max<sreg>(inUseBytes, 0);
+    return stats;
+}
+
+static int compareLiveBytes(const void* a, const void* b) {
+    ureg liveA = ((const Heap_DL::SiteStats*) a)->liveBytes;
+    ureg liveB = ((const Heap_DL::SiteStats*) b)->liveBytes;
+    return (liveA < liveB) - (liveA > liveB);
+}
+
+void Heap_DL::dumpSiteStats() {
+    SiteStats* siteStats = (SiteStats*) allocRaw(sizeof(SiteStats) * (MaxSites + 1));
+    if (!siteStats)
+        return;
+    ureg numSites = getSiteStats(siteStats, MaxSites + 1);
+    qsort(siteStats, numSites, sizeof(SiteStats), compareLiveBytes);
+    printf("%14s %10s %14s %10s  %s\n", "live bytes", "live", "total bytes", "total", "site");
+    for (ureg i = 0; i < numSites; i++) {
+        const SiteStats& stats = siteStats[i];
+        printf("%14" TURF_UREGD " %10" TURF_UREGD " %14" TURF_UREGD " %10" TURF_UREGD "  %s\n", stats.liveBytes,
+               stats.liveCount, stats.totalBytes, stats.totalCount, stats.site ? stats.site : "(other)");
+    }
+    freeRaw(siteStats);
+}
+#endif // TURF_DLMALLOC_SITE_STATS
+
+#if TURF_DLMALLOC_THREAD_CACHE
+TURF_THREAD_LOCAL Heap_DL::ThreadCache* Heap_DL::s_threadCache = NULL;
+
+//---------------------------------------------------------
+// TURF_THREAD_LOCAL variables have no destructors, so each thread that creates a cache also sets a TLS key whose
+// destructor destroys the thread's caches. The key's value is only a flag; the caches are found through s_threadCache.
+// The key is created on first use, since Heap_DL can be used before static constructors run.
+//---------------------------------------------------------
+struct Heap_DL::ThreadExitHook {
+#if TURF_TARGET_WIN32
+    static DWORD key;
+#else
+    static pthread_key_t key;
+#endif
+    static bool created; // Protected by the Lock in registerCurrentThread
+
+    static void destroyCaches() {
+        ThreadCache* cache = s_threadCache;
+        s_threadCache = NULL;
+        while (cache) {
+            ThreadCache* next = cache->nextInThread;
+            cache->heap->destroyThreadCache(cache);
+            cache = next;
+        }
+    }
+
+#if TURF_TARGET_WIN32
+    static void NTAPI onThreadExit(PVOID) {
+        destroyCaches();
+    }
+#else
+    static void onThreadExit(void*) {
+        // If a later destructor allocates again, the thread registers again, and POSIX calls this again.
+        destroyCaches();
+    }
+#endif
+
+    static void registerCurrentThread() {
+        static Lock initMutex;
+        {
+            LockGuard<Lock> guard(initMutex);
+            if (!created) {
+#if TURF_TARGET_WIN32
+                key = FlsAlloc(onThreadExit);
+                TURF_ASSERT(key != FLS_OUT_OF_INDEXES);
+#else
+                int rc = pthread_key_create(&key, onThreadExit);
+                TURF_ASSERT(rc == 0);
+                TURF_UNUSED(rc);
+#endif
+                created = true;
+            }
+        }
+#if TURF_TARGET_WIN32
+        FlsSetValue(key, (PVOID) 1);
+#else
+        pthread_setspecific(key, (void*) 1);
+#endif
+    }
+};
+
+#if TURF_TARGET_WIN32
+DWORD Heap_DL::ThreadExitHook::key;
+#else
+pthread_key_t Heap_DL::ThreadExitHook::key;
+#endif
+bool Heap_DL::ThreadExitHook::created;
+
+Heap_DL::ThreadCache* Heap_DL::getThreadCacheSlow() {
+    // Look for this heap's cache among the other caches used by this thread, and move it to the front.
+    ThreadCache* prev = NULL;
+    for (ThreadCache* cache = s_threadCache; cache; prev = cache, cache = cache->nextInThread) {
+        if (cache->heap == this) {
+            if (prev) {
+                prev->nextInThread = cache->nextInThread;
+                cache->nextInThread = s_threadCache;
+                s_threadCache = cache;
+            }
+            return cache;
+        }
+    }
+
+    // First time this thread uses this heap.
+    if (!s_threadCache)
+        ThreadExitHook::registerCurrentThread();
+    ensureInitialized();
+    TID::TID tid = TID::getCurrentThreadID();
+    LockGuard<Lock> guard(m_arenas[0].mutex);
+    // Caches are destroyed when their thread exits, but if the thread exited in a way that skipped that, and this
+    // thread reuses its ID, adopt its cache along with any blocks still in it.
+    ThreadCache* cache = m_threadCaches;
+    while (cache && cache->tid != tid)
+        cache = cache->nextInHeap;
+    if (!cache) {
+        cache = (ThreadCache*) memory_dl::dlmalloc(sizeof(ThreadCache), &m_arenas[0].mstate);
+        TURF_ASSERT(cache);
+        memset(cache, 0, sizeof(ThreadCache));
+        cache->heap = this;
+        cache->tid = tid;
+        cache->nextInHeap = m_threadCaches;
+        m_threadCaches = cache;
+    }
+    cache->nextInThread = s_threadCache;
+    s_threadCache = cache;
+    return cache;
+}
+
+void Heap_DL::destroyThreadCache(ThreadCache* cache) {
+    for (ureg i = 0; i < ThreadCache::NumClasses; i++)
+        flush(cache->bins[i], cache->bins[i].count);
+    LockGuard<Lock> guard(m_arenas[0].mutex);
+    ThreadCache** link = &m_threadCaches;
+    while (*link != cache)
+        link = &(*link)->nextInHeap;
+    *link = cache->nextInHeap;
+    memory_dl::dlfree(cache, &m_arenas[0].mstate);
+}
+
+void* Heap_DL::refill(ThreadCache::Bin& bin, ureg classIndex) {
+    ureg size = (classIndex + 1) * ThreadCache::ClassGranularity;
+    Arena& arena = getArena();
+    LockGuard<Lock> guard(arena.mutex);
+    void* result = memory_dl::dlmalloc(size, &arena.mstate);
+    for (ureg i = 1; i < ThreadCache::RefillCount; i++) {
+        void* ptr = memory_dl::dlmalloc(size, &arena.mstate);
+        if (!ptr)
+            break;
+        *(void**) ptr = bin.head;
+        bin.head = ptr;
+        bin.count++;
+    }
+    return result;
+}
+
+void Heap_DL::flush(ThreadCache::Bin& bin, ureg count) {
+    if (count == 0)
+        return;
+    // Blocks may have been allocated by other threads' arenas; freeBatch sorts that out.
+    TURF_ASSERT(count <= ThreadCache::MaxCount);
+    void* ptrs[ThreadCache::MaxCount];
+    for (ureg i = 0; i < count; i++) {
+        ptrs[i] = bin.head;
+        bin.head = *(void**) bin.head;
+    }
+    bin.count -= count;
+    freeBatch(ptrs, count);
+}
+#endif // TURF_DLMALLOC_THREAD_CACHE
+
 } // namespace turf
 
 #endif // TURF_USE_DLMALLOC
@@ -14,9 +14,31 @@
 #define TURF_IMPL_HEAP_DL_H
 
 #include <turf/Core.h>
+#include <turf/Mutex.h>
+#if TURF_KERNEL_LINUX
+#include <turf/impl/Mutex_Futex.h>
+#else
 #include <turf/impl/Mutex_LazyInit.h>
+#endif
+#if TURF_DLMALLOC_THREAD_CACHE || TURF_DLMALLOC_SITE_STATS
+#include <turf/TID.h>
+#endif
+#if TURF_DLMALLOC_SITE_STATS
+#include <turf/Util.h>
+#endif
+#if TURF_DLMALLOC_SAMPLING
+#include <turf/impl/HeapSampler.h>
+#endif
+#include <turf/Atomic.h>
 #include <string.h>
 
+// Each Heap_DL is split into this many arenas, each with its own lock and malloc_state.
+// Threads are assigned to arenas round-robin, so threads on different arenas don't contend.
+// When greater than 1, every chunk records its owning arena in a footer, which costs one extra word per chunk.
+#ifndef TURF_DLMALLOC_NUM_ARENAS
+#define TURF_DLMALLOC_NUM_ARENAS 1
+#endif
+
 namespace turf {
 namespace memory_dl {
 
@@ -79,7 +101,7 @@ struct malloc_state {
     size_t magic;
     mchunkptr smallbins[(NSMALLBINS + 1) * 2];
     tbinptr treebins[NTREEBINS];
-    size_t footprint;
+    Atomic<ureg> footprint; // Changes under the arena's lock, but Heap_DL::Operator::getFootprint reads it without
     size_t max_footprint;
     size_t footprint_limit; /* zero means no limit */
     flag_t mflags;
@@ -106,20 +128,270 @@ size_t dlmalloc_max_footprint(mstate);
 size_t dlmalloc_footprint_limit(mstate);
 size_t dlmalloc_set_footprint_limit(size_t bytes, mstate);
 void** dlindependent_calloc(size_t, size_t, void**, mstate);
+void** dlindependent_malloc(size_t, size_t, void**, mstate);
 void** dlindependent_comalloc(size_t, size_t*, void**, mstate);
 size_t dlbulk_free(void**, size_t n_elements, mstate);
 void* dlpvalloc(size_t, mstate);
 int dlmalloc_trim(size_t, mstate);
+size_t dlmalloc_release_free_pages(mstate);
 void dlmalloc_stats(mstate, Stats&);
 size_t dlmalloc_usable_size(void*);
+void dlmalloc_init();
+mstate dlmalloc_owner(void*);
 //-----------------------------------------------------
 
 } // namespace memory_dl
 
 class Heap_DL {
 private:
-    memory_dl::malloc_state m_mstate;
-    Mutex_LazyInit m_mutex;
+    // Both lock types are valid when zero-init, which lets Heap_DL live at global scope.
+    // Mutex_Futex doesn't need the lazy init step, so prefer it where available.
+#if TURF_KERNEL_LINUX
+    typedef Mutex_Futex Lock;
+#else
+    typedef Mutex_LazyInit Lock;
+#endif
+
+    static const ureg NumArenas = TURF_DLMALLOC_NUM_ARENAS;
+
+    struct Arena {
+        memory_dl::malloc_state mstate; // Must be first, so that dlmalloc_owner() can be cast to Arena*
+        Lock mutex;
+    };
+
+    Arena m_arenas[NumArenas];
+
+#if TURF_DLMALLOC_NUM_ARENAS > 1
+    static TURF_THREAD_LOCAL ureg s_arenaSlot; // Zero until the thread first uses any Heap_DL
+    static Atomic<ureg> s_nextArenaSlot;
+    static Atomic<u32> s_initialized;
+
+    TURF_NO_INLINE static void initialize();
+    TURF_NO_INLINE static ureg assignArenaSlot();
+#endif
+
+    // With several arenas, dlmalloc must be initialized before any arena is locked. A single arena initializes
+    // dlmalloc itself, under its own lock.
+    static void ensureInitialized() {
+#if TURF_DLMALLOC_NUM_ARENAS > 1
+        if (!s_initialized.load(turf::Acquire))
+            initialize();
+#endif
+    }
+
+    Arena& getArena() {
+#if TURF_DLMALLOC_NUM_ARENAS > 1
+        ureg slot = s_arenaSlot;
+        if (!slot)
+            slot = assignArenaSlot();
+        return m_arenas[slot % NumArenas];
+#else
+        return m_arenas[0];
+#endif
+    }
+
+    // The arena that allocated ptr, which may belong to another thread.
+    Arena& getOwner(void* ptr) {
+#if TURF_DLMALLOC_NUM_ARENAS > 1
+        Arena* arena = (Arena*) memory_dl::dlmalloc_owner(ptr);
+        TURF_ASSERT(arena);
+        return *arena;
+#else
+        TURF_UNUSED(ptr);
+        return m_arenas[0];
+#endif
+    }
+
+    void freeBatch(void** ptrs, ureg count);
+
+#if TURF_DLMALLOC_THREAD_CACHE
+    // Each thread keeps a cache of small blocks for every Heap_DL it uses.
+    // Blocks move between the cache and the arenas in batches, so most small allocations and frees don't lock.
+    // Cached blocks are ordinary dlmalloc chunks, so they count as in use in getStats().
+    // When the thread exits, its caches are flushed and freed.
+    struct ThreadCache {
+        static const ureg ClassGranularity = 16;
+        static const ureg NumClasses = 16; // Block sizes 16, 32, ..., 256
+        static const ureg MaxSize = NumClasses * ClassGranularity;
+        static const ureg RefillCount = 16;
+        static const ureg MaxCount = 64; // Per class. Beyond this, half the class is flushed.
+
+        struct Bin {
+            void* head;
+            ureg count;
+        };
+
+        Heap_DL* heap;
+        TID::TID tid;
+        ThreadCache* nextInHeap;   // Protected by heap->m_arenas[0].mutex
+        ThreadCache* nextInThread; // Next cache used by the same thread, for another Heap_DL
+        Bin bins[NumClasses];
+    };
+
+    ThreadCache* m_threadCaches; // Protected by m_arenas[0].mutex
+
+    static TURF_THREAD_LOCAL ThreadCache* s_threadCache; // Most recently used by the current thread
+
+    struct ThreadExitHook; // Calls destroyThreadCache on every cache of an exiting thread
+
+    ThreadCache* getThreadCache() {
+        ThreadCache* cache = s_threadCache;
+        if (cache && cache->heap == this)
+            return cache;
+        return getThreadCacheSlow();
+    }
+
+    TURF_NO_INLINE ThreadCache* getThreadCacheSlow();
+    TURF_NO_INLINE void* refill(ThreadCache::Bin& bin, ureg classIndex);
+    TURF_NO_INLINE void flush(ThreadCache::Bin& bin, ureg count);
+    void destroyThreadCache(ThreadCache* cache);
+
+    void* allocSmall(ureg size) {
+        ureg classIndex = size > 0 ? (size - 1) / ThreadCache::ClassGranularity : 0;
+        ThreadCache::Bin& bin = getThreadCache()->bins[classIndex];
+        void* ptr = bin.head;
+        if (!ptr)
+            return refill(bin, classIndex);
+        bin.head = *(void**) ptr;
+        bin.count--;
+        return ptr;
+    }
+
+    bool freeSmall(void* ptr) {
+        // Put the block in the largest class it can hold. Also rejects NULL, whose usable size is 0.
+        ureg classIndex = memory_dl::dlmalloc_usable_size(ptr) / ThreadCache::ClassGranularity - 1;
+        if (classIndex >= ThreadCache::NumClasses)
+            return false;
+        ThreadCache::Bin& bin = getThreadCache()->bins[classIndex];
+        *(void**) ptr = bin.head;
+        bin.head = ptr;
+        if (++bin.count > ThreadCache::MaxCount)
+            flush(bin, ThreadCache::MaxCount / 2);
+        return true;
+    }
+#endif
+
+#if TURF_DLMALLOC_SITE_STATS
+    // Every block starts with a SiteHeader, so that frees are charged to the call site that allocated the block.
+    struct SiteHeader {
+        uptr site; // Site*. The low bit is set if the block is over-aligned; then the raw block precedes the header.
+        ureg size; // Requested size
+    };
+    static const ureg SiteHeaderSize = sizeof(SiteHeader); // Same as dlmalloc's alignment, so blocks stay aligned
+
+    struct Site {
+        static const ureg NumShards = 8;
+        // Each thread updates the shard selected by its ID, so threads rarely share a cache line.
+        // Live counts may wrap below zero in a single shard; only the sum across shards is meaningful.
+        struct Shard {
+            Atomic<ureg> liveBytes;
+            Atomic<ureg> liveCount;
+            Atomic<ureg> totalBytes;
+            Atomic<ureg> totalCount;
+            u8 padding[TURF_CACHE_LINE_SIZE - 4 * sizeof(Atomic<ureg>)];
+        };
+        Shard shards[NumShards];
+        const char* name; // NULL for m_overflowSite
+    };
+
+    static const ureg MaxSites = 1024;
+    Atomic<Site*> m_sites[MaxSites]; // Open addressing, keyed by the address of the call site string
+    Site m_overflowSite;             // Shared by the call sites that don't fit in m_sites
+
+    static ureg hashSite(const char* name) {
+        return (ureg) util::avalanche((u64) (uptr) name);
+    }
+
+    Site* getSite(const char* name) {
+        Site* site = m_sites[hashSite(name) & (MaxSites - 1)].load(turf::Acquire);
+        if (site && site->name == name)
+            return site;
+        return getSiteSlow(name);
+    }
+
+    TURF_NO_INLINE Site* getSiteSlow(const char* name);
+
+    static Site::Shard& getShard(Site* site) {
+        return site->shards[util::avalanche((u64) TID::getCurrentThreadID()) & (Site::NumShards - 1)];
+    }
+
+    void* track(void* raw, ureg size, const char* name) {
+        if (!raw)
+            return NULL;
+        Site* site = getSite(name);
+        SiteHeader* header = (SiteHeader*) raw;
+        header->site = (uptr) site;
+        header->size = size;
+        Site::Shard& shard = getShard(site);
+        shard.liveBytes.fetchAdd(size, turf::Relaxed);
+        shard.liveCount.fetchAdd(1, turf::Relaxed);
+        shard.totalBytes.fetchAdd(size, turf::Relaxed);
+        shard.totalCount.fetchAdd(1, turf::Relaxed);
+        return header + 1;
+    }
+
+    static void* getRaw(void* ptr) {
+        SiteHeader* header = (SiteHeader*) ptr - 1;
+        return (header->site & 1) ? ((void**) header)[-1] : (void*) header;
+    }
+
+    // Returns the raw block.
+    void* untrack(void* ptr) {
+        SiteHeader* header = (SiteHeader*) ptr - 1;
+        Site::Shard& shard = getShard((Site*) (header->site & ~uptr(1)));
+        shard.liveBytes.fetchSub(header->size, turf::Relaxed);
+        shard.liveCount.fetchSub(1, turf::Relaxed);
+        return getRaw(ptr);
+    }
+
+    void* trackAligned(ureg size, ureg alignment, const char* name);
+    void* trackRealloc(void* ptr, ureg newSize, const char* name);
+#endif
+
+#if TURF_DLMALLOC_SAMPLING
+    HeapSampler m_sampler;
+#endif
+
+    void* allocRaw(ureg size) {
+#if TURF_DLMALLOC_THREAD_CACHE
+        if (size <= ThreadCache::MaxSize)
+            return allocSmall(size);
+#endif
+        Arena& arena = getArena();
+        LockGuard<Lock> guard(arena.mutex);
+        return memory_dl::dlmalloc((size_t) size, &arena.mstate);
+    }
+
+    void* allocAlignedRaw(ureg size, ureg alignment) {
+        Arena& arena = getArena();
+        LockGuard<Lock> guard(arena.mutex);
+        return memory_dl::dlmemalign((size_t) alignment, (size_t) size, &arena.mstate);
+    }
+
+    void* reallocRaw(void* ptr, ureg newSize) {
+        // Blocks are resized within the arena that owns them.
+        Arena& arena = ptr ? getOwner(ptr) : getArena();
+        LockGuard<Lock> guard(arena.mutex);
+        return memory_dl::dlrealloc(ptr, (size_t) newSize, &arena.mstate);
+    }
+
+    void freeRaw(void* ptr) {
+        if (!ptr)
+            return;
+#if TURF_DLMALLOC_THREAD_CACHE
+        if (freeSmall(ptr))
+            return;
+#endif
+        Arena& arena = getOwner(ptr);
+        LockGuard<Lock> guard(arena.mutex);
+        memory_dl::dlfree(ptr, &arena.mstate);
+    }
+
+    bool allocBatchRaw(ureg size, ureg count, void** out) {
+        Arena& arena = getArena();
+        LockGuard<Lock> guard(arena.mutex);
+        return memory_dl::dlindependent_malloc((size_t) count, (size_t) size, out, &arena.mstate) != NULL;
+    }
 
 public:
     // If you create a Heap_DL at global scope, it will be automatically
@@ -131,57 +403,269 @@ public:
 
     typedef memory_dl::Stats Stats;
 
+#if TURF_DLMALLOC_SITE_STATS
+    struct SiteStats {
+        const char* site; // NULL for call sites that didn't fit in the table
+        ureg liveBytes;
+        ureg liveCount;
+        ureg totalBytes;
+        ureg totalCount;
+    };
+
+    ureg getSiteStats(SiteStats* out, ureg maxSites);
+    Stats getApproxStats();
+    void dumpSiteStats();
+#endif
+
     class Operator {
     private:
         Heap_DL& m_mem;
+#if TURF_DLMALLOC_SITE_STATS || TURF_DLMALLOC_SAMPLING
+        const char* m_site;
+#endif
 
     public:
+#if TURF_DLMALLOC_SITE_STATS || TURF_DLMALLOC_SAMPLING
+        Operator(Heap_DL& mem, const char* site) : m_mem(mem), m_site(site) {
+        }
+#else
         Operator(Heap_DL& mem) : m_mem(mem) {
         }
+#endif
 
         // There may also be extra indirection/checks inside the functions
         void* alloc(ureg size) {
-            LockGuard<Mutex_LazyInit> guard(m_mem.m_mutex);
-            return memory_dl::dlmalloc((size_t) size, &m_mem.m_mstate);
+#if TURF_DLMALLOC_SITE_STATS
+            void* ptr = m_mem.track(m_mem.allocRaw(size + SiteHeaderSize), size, m_site);
+#else
+            void* ptr = m_mem.allocRaw(size);
+#endif
+#if TURF_DLMALLOC_SAMPLING
+            m_mem.m_sampler.onAlloc(ptr, size, m_site);
+#endif
+            return ptr;
         }
 
         void* allocAligned(ureg size, ureg alignment) {
-            LockGuard<Mutex_LazyInit> guard(m_mem.m_mutex);
-            return memory_dl::dlmemalign((size_t) alignment, (size_t) size, &m_mem.m_mstate);
+#if TURF_DLMALLOC_SITE_STATS
+            void* ptr = m_mem.trackAligned(size, alignment, m_site);
+#else
+            void* ptr = m_mem.allocAlignedRaw(size, alignment);
+#endif
+#if TURF_DLMALLOC_SAMPLING
+            m_mem.m_sampler.onAlloc(ptr, size, m_site);
+#endif
+            return ptr;
         }
 
         void* realloc(void* ptr, ureg newSize) {
-            LockGuard<Mutex_LazyInit> guard(m_mem.m_mutex);
-            return memory_dl::dlrealloc(ptr, (size_t) newSize, &m_mem.m_mstate);
+#if TURF_DLMALLOC_SITE_STATS
+            void* result = m_mem.trackRealloc(ptr, newSize, m_site);
+#else
+            void* result = m_mem.reallocRaw(ptr, newSize);
+#endif
+#if TURF_DLMALLOC_SAMPLING
+            // Treated as a free followed by an allocation, even when the block is resized in place. If the realloc
+            // fails, the old block is still live, so it keeps its sample.
+            if (ptr && result)
+                m_mem.m_sampler.onFree(ptr);
+            m_mem.m_sampler.onAlloc(result, newSize, m_site);
+#endif
+            return result;
         }
 
         void free(void* ptr) {
-            LockGuard<Mutex_LazyInit> guard(m_mem.m_mutex);
-            return memory_dl::dlfree(ptr, &m_mem.m_mstate);
+#if TURF_DLMALLOC_SAMPLING
+            if (ptr)
+                m_mem.m_sampler.onFree(ptr);
+#endif
+#if TURF_DLMALLOC_SITE_STATS
+            if (ptr)
+                m_mem.freeRaw(m_mem.untrack(ptr));
+#else
+            m_mem.freeRaw(ptr);
+#endif
+        }
+
+        // Allocates count blocks of the same size into out[], locking once. The blocks are carved from a single chunk,
+        // but each one can be freed or reallocated on its own. On failure, returns false and allocates nothing.
+        bool allocBatch(ureg size, ureg count, void** out) {
+#if TURF_DLMALLOC_SITE_STATS
+            if (!m_mem.allocBatchRaw(size + SiteHeaderSize, count, out))
+                return false;
+            for (ureg i = 0; i < count; i++)
+                out[i] = m_mem.track(out[i], size, m_site);
+#else
+            if (!m_mem.allocBatchRaw(size, count, out))
+                return false;
+#endif
+#if TURF_DLMALLOC_SAMPLING
+            for (ureg i = 0; i < count; i++)
+                m_mem.m_sampler.onAlloc(out[i], size, m_site);
+#endif
+            return true;
+        }
+
+        // Frees count blocks, locking once per owning arena rather than once per block. NULL entries are skipped.
+        // Overwrites ptrs[]. Blocks that are adjacent in memory and in ptrs[], like those returned by allocBatch,
+        // are coalesced before being binned.
+        void freeBatch(void** ptrs, ureg count) {
+#if TURF_DLMALLOC_SAMPLING
+            for (ureg i = 0; i < count; i++) {
+                if (ptrs[i])
+                    m_mem.m_sampler.onFree(ptrs[i]);
+            }
+#endif
+#if TURF_DLMALLOC_SITE_STATS
+            for (ureg i = 0; i < count; i++) {
+                if (ptrs[i])
+                    ptrs[i] = m_mem.untrack(ptrs[i]);
+            }
+#endif
+            m_mem.freeBatch(ptrs, count);
+        }
+
+#if TURF_DLMALLOC_THREAD_CACHE
+        // Returns the calling thread's cached blocks to the heap. Exiting threads do this automatically.
+        void flushThreadCache() {
+            ThreadCache* cache = m_mem.getThreadCache();
+            for (ureg i = 0; i < ThreadCache::NumClasses; i++)
+                m_mem.flush(cache->bins[i], cache->bins[i].count);
         }
+#endif
 
+        // Totals across all arenas. Each arena is locked in turn, so the totals are not a single snapshot.
         Stats getStats() {
-            Stats stats;
-            LockGuard<Mutex_LazyInit> guard(m_mem.m_mutex);
-            memory_dl::dlmalloc_stats(&m_mem.m_mstate, stats);
+            ensureInitialized();
+            Stats stats = {0, 0, 0};
+            for (ureg i = 0; i < NumArenas; i++) {
+                Arena& arena = m_mem.m_arenas[i];
+                Stats arenaStats;
+                LockGuard<Lock> guard(arena.mutex);
+                memory_dl::dlmalloc_stats(&arena.mstate, arenaStats);
+                stats.peakSystemBytes += arenaStats.peakSystemBytes;
+                stats.systemBytes += arenaStats.systemBytes;
+                stats.inUseBytes += arenaStats.inUseBytes;
+            }
             return stats;
         }
 
+        // Total memory mapped from the OS by all arenas. Doesn't lock. Each arena's footprint is read atomically, but
+        // the arenas are read one at a time.
+        ureg getFootprint() const {
+            ureg footprint = 0;
+            for (ureg i = 0; i < NumArenas; i++)
+                footprint += m_mem.m_arenas[i].mstate.footprint.load(turf::Relaxed);
+            return footprint;
+        }
+
+        // Returns free memory to the OS, and returns the number of bytes released:
+        // - Segments that no longer hold any blocks, and the free space at the top of each arena beyond pad bytes,
+        //   are unmapped, which reduces the footprint.
+        // - The pages inside other large free chunks are decommitted and committed again. They stay mapped and count
+        //   toward the footprint, but no longer use physical memory. Each chunk is only counted by the first call
+        //   that releases its pages.
+        // Blocks held in thread caches count as live. Nothing calls this automatically; call it after a load spike,
+        // or periodically from an idle thread.
+        ureg trim(ureg pad = 0) {
+            ensureInitialized();
+            ureg released = 0;
+            for (ureg i = 0; i < NumArenas; i++) {
+                Arena& arena = m_mem.m_arenas[i];
+                LockGuard<Lock> guard(arena.mutex);
+                ureg before = memory_dl::dlmalloc_footprint(&arena.mstate);
+                memory_dl::dlmalloc_trim((size_t) pad, &arena.mstate);
+                released += before - memory_dl::dlmalloc_footprint(&arena.mstate);
+                released += memory_dl::dlmalloc_release_free_pages(&arena.mstate);
+            }
+            return released;
+        }
+
+        // Trims only when the total footprint exceeds highWaterBytes. Below it, doesn't lock, so it's cheap
+        // enough to call after every unit of work.
+        ureg trimIfAbove(ureg highWaterBytes, ureg pad = 0) {
+            if (getFootprint() <= highWaterBytes)
+                return 0;
+            return trim(pad);
+        }
+
+        // Limits the footprint of each arena. Allocations that would take an arena beyond the limit fail.
+        // Zero removes the limit.
+        void setFootprintLimit(ureg bytesPerArena) {
+            ensureInitialized();
+            for (ureg i = 0; i < NumArenas; i++) {
+                Arena& arena = m_mem.m_arenas[i];
+                LockGuard<Lock> guard(arena.mutex);
+                memory_dl::dlmalloc_set_footprint_limit(bytesPerArena ? (size_t) bytesPerArena : ~size_t(0),
+                                                        &arena.mstate);
+            }
+        }
+
+#if TURF_DLMALLOC_SITE_STATS
+        // Copies the stats of up to maxSites call sites into out[], and returns the total number of call sites.
+        // Doesn't lock, so it's cheap enough to scrape periodically, but the counters are read one at a time.
+        ureg getSiteStats(SiteStats* out, ureg maxSites) {
+            return m_mem.getSiteStats(out, maxSites);
+        }
+
+        // Doesn't lock, unlike getStats(). inUseBytes is the total requested size of live blocks.
+        Stats getApproxStats() {
+            return m_mem.getApproxStats();
+        }
+
+        // Prints every call site to stdout, largest live size first.
+        void dumpSiteStats() {
+            m_mem.dumpSiteStats();
+        }
+#endif
+
+#if TURF_DLMALLOC_SAMPLING
+        // Sets the mean number of bytes allocated between samples. Zero turns sampling off.
+        void setSampleInterval(ureg interval) {
+            m_mem.m_sampler.setInterval(interval);
+        }
+
+        // Writes the sampled live blocks to path as a heap profile that pprof can read. Returns false if the file
+        // couldn't be opened or written.
+        bool dumpHeapProfile(const char* path) {
+            return m_mem.m_sampler.dumpProfile(path);
+        }
+
+        // Prints the estimated live size of each call site to stdout, based on the samples, largest first.
+        void dumpSampledSites() {
+            m_mem.m_sampler.dumpSites();
+        }
+#endif
+
 #if TURF_DLMALLOC_FAST_STATS
         ureg getInUseBytes() const {
-            return m_mem.m_mstate.inUseBytes;
+            ureg inUseBytes = 0;
+            for (ureg i = 0; i < NumArenas; i++)
+                inUseBytes += m_mem.m_arenas[i].mstate.inUseBytes;
+            return inUseBytes;
         }
 #endif
     };
 
     ureg getSize(void* ptr) {
         // No need to lock
+#if TURF_DLMALLOC_SITE_STATS
+        void* raw = getRaw(ptr);
+        return memory_dl::dlmalloc_usable_size(raw) - ((u8*) ptr - (u8*) raw);
+#else
         return memory_dl::dlmalloc_usable_size(ptr);
+#endif
     }
 
+#if TURF_DLMALLOC_SITE_STATS || TURF_DLMALLOC_SAMPLING
+    Operator operate(const char* site) {
+        return Operator(*this, site);
+    }
+#else
     Operator operate(const char*) {
         return Operator(*this);
     }
+#endif
 };
 
 } // namespace turf
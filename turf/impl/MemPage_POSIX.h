@@ -14,29 +14,203 @@
 #define TURF_IMPL_MEMPAGE_POSIX_H
 
 #include <turf/Core.h>
+#include <turf/Assert.h>
+#include <turf/Util.h>
 #include <unistd.h>
 #include <sys/mman.h>
+#if TURF_KERNEL_LINUX
+#include <sys/syscall.h>
+#include <stdio.h>
+#endif
 
 namespace turf {
 
 class MemPage_POSIX {
 public:
+    enum Flags {
+        TopDown = 0x1,    // Ignored on POSIX
+        LargePages = 0x2, // Back with large pages if possible
+        Populate = 0x4,   // Fault in every page before returning
+    };
+
     static ureg getPageSize(ureg& allocAlignment) {
         long result = sysconf(_SC_PAGE_SIZE);
         allocAlignment = result;
         return result;
     }
 
+    // Returns 0 if large pages aren't supported.
+    static ureg getLargePageSize() {
+#if TURF_KERNEL_LINUX
+        static ureg largePageSize = readLargePageSize();
+        return largePageSize;
+#else
+        return 0;
+#endif
+    }
+
     static bool alloc(void*& result, ureg size, bool topDownHint = false) {
+        TURF_UNUSED(topDownHint);
         result = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-        TURF_ASSERT(result != MAP_FAILED);
+        if (result == MAP_FAILED) {
+            result = NULL;
+            return false;
+        }
         return true;
     }
 
-    static bool free(void* ptr, ureg size) {
-        munmap(ptr, size);
+    // Each flag and the NUMA node are a request. When one can't be honored, it's ignored and the
+    // allocation proceeds with normal pages. numaNode = -1 means no binding.
+    static bool alloc(void*& result, ureg size, u32 flags, s32 numaNode) {
+        const int prot = PROT_READ | PROT_WRITE;
+        const int mapFlags = MAP_PRIVATE | MAP_ANONYMOUS;
+        // Keeps the trims below page-aligned. free() rounds the same way.
+        ureg pageSize = sysconf(_SC_PAGE_SIZE);
+        size = util::align(size, pageSize);
+        ureg largePageSize = (flags & LargePages) ? getLargePageSize() : 0;
+        // Pages must not be faulted in before they're bound to a node or marked for transparent huge pages.
+        // In those cases, populate them afterwards instead of with MAP_POPULATE.
+        bool populateLater = (flags & Populate) && (numaNode >= 0 || largePageSize);
+        int populateFlag = 0;
+#ifdef MAP_POPULATE
+        if ((flags & Populate) && !populateLater)
+            populateFlag = MAP_POPULATE;
+#else
+        populateLater = (flags & Populate) != 0;
+#endif
+        result = MAP_FAILED;
+#ifdef MAP_HUGETLB
+        // Explicit huge pages only work if the administrator reserved some, and the size is a multiple of the page size.
+        if (largePageSize && size % largePageSize == 0)
+            result = mmap(0, size, prot, mapFlags | MAP_HUGETLB, -1, 0);
+#endif
+        if (result == MAP_FAILED) {
+            if (largePageSize && size >= largePageSize) {
+                // Transparent huge pages can only back aligned regions, so over-allocate and trim to alignment.
+                void* mem = mmap(0, size + largePageSize, prot, mapFlags, -1, 0);
+                if (mem == MAP_FAILED)
+                    return false;
+                ureg head = util::align((ureg) mem, largePageSize) - (ureg) mem;
+                if (head > 0 && munmap(mem, head) != 0) {
+                    munmap(mem, size + largePageSize);
+                    return false;
+                }
+                if (munmap((u8*) mem + head + size, largePageSize - head) != 0) {
+                    munmap((u8*) mem + head, size + largePageSize - head);
+                    return false;
+                }
+                result = (u8*) mem + head;
+#ifdef MADV_HUGEPAGE
+                madvise(result, size, MADV_HUGEPAGE);
+#endif
+            } else {
+                result = mmap(0, size, prot, mapFlags | populateFlag, -1, 0);
+                if (result == MAP_FAILED)
+                    return false;
+            }
+        }
+        if (numaNode >= 0)
+            bindToNode(result, size, numaNode);
+        if (populateLater) {
+            for (ureg offset = 0; offset < size; offset += pageSize)
+                ((volatile u8*) result)[offset] = 0;
+        }
         return true;
     }
+
+    static bool free(void* ptr, ureg size) {
+        ureg pageSize = sysconf(_SC_PAGE_SIZE);
+        return munmap(ptr, util::align(size, pageSize)) == 0;
+    }
+
+    // Reserves address space without backing it with memory. Pages must be committed before they're accessed.
+    // Addresses and sizes passed to the functions below must be multiples of the page size.
+    static bool reserve(void*& result, ureg size) {
+        int mapFlags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_NORESERVE
+        mapFlags |= MAP_NORESERVE;
+#endif
+        result = mmap(0, size, PROT_NONE, mapFlags, -1, 0);
+        return result != MAP_FAILED;
+    }
+
+    // Makes reserved pages accessible. They read as zero until written.
+    static bool commit(void* ptr, ureg size) {
+        return mprotect(ptr, size, PROT_READ | PROT_WRITE) == 0;
+    }
+
+    // Returns the pages' memory to the system immediately, and makes them inaccessible until they're committed again.
+    // The address range stays reserved.
+    static bool decommit(void* ptr, ureg size) {
+        if (mprotect(ptr, size, PROT_NONE) != 0)
+            return false;
+        return madvise(ptr, size, MADV_DONTNEED) == 0;
+    }
+
+    // Tells the system it may reclaim the pages' memory whenever it needs to. The pages stay committed, but their
+    // contents become undefined. This is cheaper than decommit() when the pages will soon be written again.
+    static bool discard(void* ptr, ureg size) {
+#ifdef MADV_FREE
+        if (madvise(ptr, size, MADV_FREE) == 0)
+            return true;
+        // MADV_FREE needs Linux 4.5. Fall through.
+#endif
+        return madvise(ptr, size, MADV_DONTNEED) == 0;
+    }
+
+    // Returns the pages' memory to the system immediately, like decommit() followed by commit(), but without changing
+    // their protection, which would cost two more system calls and split the mapping. They read as zero until
+    // written. Also works on pages from alloc().
+    static bool purge(void* ptr, ureg size) {
+#if TURF_KERNEL_LINUX
+        return madvise(ptr, size, MADV_DONTNEED) == 0;
+#else
+        // Elsewhere, MADV_DONTNEED may leave the contents in place. Map fresh zero pages over the range instead.
+        return mmap(ptr, size, PROT_READ | PROT_WRITE, MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS, -1, 0) != MAP_FAILED;
+#endif
+    }
+
+    // Releases a range obtained from reserve(), whether committed or not.
+    static bool release(void* ptr, ureg size) {
+        return munmap(ptr, size) == 0;
+    }
+
+private:
+#if TURF_KERNEL_LINUX
+    static ureg readLargePageSize() {
+        ureg result = 0;
+        FILE* f = fopen("/proc/meminfo", "r");
+        if (f) {
+            char line[128];
+            unsigned long kb;
+            while (fgets(line, sizeof(line), f)) {
+                if (sscanf(line, "Hugepagesize: %lu kB", &kb) == 1) {
+                    result = (ureg) kb * 1024;
+                    break;
+                }
+            }
+            fclose(f);
+        }
+        return result;
+    }
+#endif
+
+    static void bindToNode(void* ptr, ureg size, s32 numaNode) {
+#if TURF_KERNEL_LINUX && defined(SYS_mbind)
+        // Calls mbind directly, so there's no dependency on libnuma. Fails harmlessly on kernels without NUMA.
+        static const int MPOL_BIND_ = 2;
+        static const ureg MaskBits = 8 * sizeof(unsigned long);
+        unsigned long nodeMask[1024 / MaskBits] = {};
+        if ((ureg) numaNode >= 1024)
+            return;
+        nodeMask[numaNode / MaskBits] = 1ul << (numaNode % MaskBits);
+        syscall(SYS_mbind, ptr, size, MPOL_BIND_, nodeMask, (unsigned long) 1024, 0u);
+#else
+        TURF_UNUSED(ptr);
+        TURF_UNUSED(size);
+        TURF_UNUSED(numaNode);
+#endif
+    }
 };
 
 } // namespace turf
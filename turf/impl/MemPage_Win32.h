@@ -14,11 +14,18 @@
 #define TURF_IMPL_MEMPAGE_WIN32_H
 
 #include <turf/Core.h>
+#include <turf/Util.h>
 
 namespace turf {
 
 class MemPage_Win32 {
 public:
+    enum Flags {
+        TopDown = 0x1,    // Allocate at the highest available address
+        LargePages = 0x2, // Back with large pages if possible. Requires SeLockMemoryPrivilege.
+        Populate = 0x4,   // Fault in every page before returning
+    };
+
     static ureg getPageSize(ureg& allocAlignment) {
         SYSTEM_INFO sysInfo;
         GetSystemInfo(&sysInfo);
@@ -26,6 +33,11 @@ public:
         return sysInfo.dwPageSize;
     }
 
+    // Returns 0 if large pages aren't supported.
+    static ureg getLargePageSize() {
+        return (ureg) GetLargePageMinimum();
+    }
+
     static bool alloc(void*& result, ureg size, bool topDownHint = false) {
         DWORD type = MEM_RESERVE | MEM_COMMIT;
         if (topDownHint)
@@ -34,7 +46,37 @@ public:
         return (result != NULL);
     }
 
+    // Each flag and the NUMA node are a request. When one can't be honored, it's ignored and the
+    // allocation proceeds with normal pages. numaNode = -1 means no binding.
+    static bool alloc(void*& result, ureg size, u32 flags, s32 numaNode) {
+        DWORD type = MEM_RESERVE | MEM_COMMIT;
+        if (flags & TopDown)
+            type |= MEM_TOP_DOWN;
+        DWORD node = numaNode >= 0 ? (DWORD) numaNode : NUMA_NO_PREFERRED_NODE;
+        result = NULL;
+        ureg largePageSize = (flags & LargePages) ? getLargePageSize() : 0;
+        if (largePageSize && size % largePageSize == 0) {
+            // Large pages are always locked in memory, so there's nothing left to populate.
+            result = VirtualAllocExNuma(GetCurrentProcess(), 0, (SIZE_T) size, type | MEM_LARGE_PAGES, PAGE_READWRITE, node);
+            if (result)
+                return true;
+        }
+        result = VirtualAllocExNuma(GetCurrentProcess(), 0, (SIZE_T) size, type, PAGE_READWRITE, node);
+        if (!result)
+            return false;
+        if (flags & Populate) {
+            SYSTEM_INFO sysInfo;
+            GetSystemInfo(&sysInfo);
+            for (ureg offset = 0; offset < size; offset += sysInfo.dwPageSize)
+                ((volatile u8*) result)[offset] = 0;
+        }
+        return true;
+    }
+
     static bool free(void* ptr, ureg size) {
+        // Regions span whole pages, so round up like alloc() did.
+        ureg allocAlignment;
+        size = util::align(size, getPageSize(allocAlignment));
         MEMORY_BASIC_INFORMATION minfo;
         while (sreg(size) > 0) {
             if (VirtualQuery((LPCVOID) ptr, &minfo, sizeof(minfo)) == 0)
@@ -48,6 +90,44 @@ public:
         }
         return true;
     }
+
+    // Reserves address space without backing it with memory. Pages must be committed before they're accessed.
+    // Addresses and sizes passed to the functions below must be multiples of the page size.
+    static bool reserve(void*& result, ureg size) {
+        result = VirtualAlloc(0, (SIZE_T) size, MEM_RESERVE, PAGE_NOACCESS);
+        return result != NULL;
+    }
+
+    // Makes reserved pages accessible. They read as zero until written.
+    static bool commit(void* ptr, ureg size) {
+        return VirtualAlloc(ptr, (SIZE_T) size, MEM_COMMIT, PAGE_READWRITE) != NULL;
+    }
+
+    // Returns the pages' memory to the system immediately, and makes them inaccessible until they're committed again.
+    // The address range stays reserved.
+    static bool decommit(void* ptr, ureg size) {
+        return VirtualFree(ptr, (SIZE_T) size, MEM_DECOMMIT) != 0;
+    }
+
+    // Tells the system it may reclaim the pages' memory whenever it needs to. The pages stay committed, but their
+    // contents become undefined. This is cheaper than decommit() when the pages will soon be written again.
+    static bool discard(void* ptr, ureg size) {
+        return VirtualAlloc(ptr, (SIZE_T) size, MEM_RESET, PAGE_READWRITE) != NULL;
+    }
+
+    // Returns the pages' memory to the system immediately, and commits them again. They read as zero until written.
+    // Also works on pages from alloc().
+    static bool purge(void* ptr, ureg size) {
+        if (!VirtualFree(ptr, (SIZE_T) size, MEM_DECOMMIT))
+            return false;
+        return VirtualAlloc(ptr, (SIZE_T) size, MEM_COMMIT, PAGE_READWRITE) != NULL;
+    }
+
+    // Releases a range obtained from reserve(), whether committed or not.
+    static bool release(void* ptr, ureg size) {
+        TURF_UNUSED(size);
+        return VirtualFree(ptr, 0, MEM_RELEASE) != 0;
+    }
 };
 
 } // namespace turf
@@ -0,0 +1,69 @@
+/*------------------------------------------------------------------------
+  Turf: Configurable C++ platform adapter
+  Copyright (c) 2016 Jeff Preshing
+
+  Distributed under the Simplified BSD License.
+  Original location: https://github.com/preshing/turf
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the LICENSE file for more information.
+------------------------------------------------------------------------*/
+
+#ifndef TURF_IMPL_MUTEX_FUTEX_H
+#define TURF_IMPL_MUTEX_FUTEX_H
+
+#include <turf/Core.h>
+#include <turf/Atomic.h>
+#include <turf/impl/Futex_Linux.h>
+
+namespace turf {
+
+// A 4-byte, non-recursive mutex built directly on the Linux futex syscall.
+// Based on "mutex3" from Ulrich Drepper's "Futexes Are Tricky".
+// The zero state is the unlocked state, so it works when zero-init at global scope,
+// and the constructor only stores that same zero state.
+// Lock states: 0 = unlocked, 1 = locked, 2 = locked with possible waiters.
+class Mutex_Futex {
+private:
+    Atomic<u32> m_state;
+
+    TURF_NO_INLINE void lockSlow(u32 state) {
+        if (state != 2)
+            state = m_state.exchange(2, turf::Acquire);
+        while (state != 0) {
+            Futex_Linux::wait(m_state, 2);
+            state = m_state.exchange(2, turf::Acquire);
+        }
+    }
+
+public:
+    Mutex_Futex() : m_state(0) {
+    }
+
+    // Manual initialization is needed if not created at global scope and not constructed:
+    void zeroInit() {
+        m_state.storeNonatomic(0);
+    }
+
+    void lock() {
+        // Uncontended fast path makes no syscall.
+        u32 expected = 0;
+        if (!m_state.compareExchangeStrong(expected, 1, turf::Acquire))
+            lockSlow(expected);
+    }
+
+    bool tryLock() {
+        u32 expected = 0;
+        return m_state.compareExchangeStrong(expected, 1, turf::Acquire);
+    }
+
+    void unlock() {
+        if (m_state.exchange(0, turf::Release) == 2)
+            Futex_Linux::wake(m_state, 1);
+    }
+};
+
+} // namespace turf
+
+#endif // TURF_IMPL_MUTEX_FUTEX_H
@@ -16,6 +16,7 @@
 #include <turf/Core.h>
 #include <turf/Atomic.h>
 #include <turf/Mutex.h>
+#include <turf/AdaptiveBackoff.h>
 #include <turf/Assert.h>
 #include <memory.h>
 
@@ -36,8 +37,9 @@ private:
         // We use the thread-safe DCLI pattern via spinlock in case threads are spawned
         // during static initialization of global C++ objects. In that case, any of them
         // could call lazyInit().
+        AdaptiveBackoff backoff;
         while (m_spinLock.compareExchange(false, true, turf::Acquire)) {
-            // FIXME: Implement reusable AdaptiveBackoff class and apply it here
+            backoff.wait();
         }
         if (!m_initFlag.loadNonatomic()) {
             new (&getMutex()) Mutex;
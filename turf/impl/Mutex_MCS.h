@@ -0,0 +1,121 @@
+/*------------------------------------------------------------------------
+  Turf: Configurable C++ platform adapter
+  Copyright (c) 2016 Jeff Preshing
+
+  Distributed under the Simplified BSD License.
+  Original location: https://github.com/preshing/turf
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the LICENSE file for more information.
+------------------------------------------------------------------------*/
+
+#ifndef TURF_IMPL_MUTEX_MCS_H
+#define TURF_IMPL_MUTEX_MCS_H
+
+#include <turf/Core.h>
+#include <turf/Atomic.h>
+#include <turf/AdaptiveBackoff.h>
+
+namespace turf {
+
+//---------------------------------------------------------
+// A fair (FIFO) queue lock. Each waiter spins only on a node in its own stack frame,
+// so waiting threads never touch a shared cache line.
+// This is the K42 variant of the MCS lock, which keeps the plain lock()/unlock() API:
+// the lock object itself stands in for the owner's queue node.
+// Works when zero-init at global scope. Not recursive.
+//---------------------------------------------------------
+class Mutex_MCS {
+private:
+    struct Node {
+        // In the lock's own node: tail of the queue, NULL if free, or the lock's node if held without waiters.
+        // In a waiter's node: Waiting until the waiter is granted the lock.
+        Atomic<Node*> tail;
+        Atomic<Node*> next;
+    };
+
+    static Node* waitingMarker() {
+        return (Node*) 1;
+    }
+
+    Node m_node;
+
+    TURF_NO_INLINE void lockSlow() {
+        for (;;) {
+            Node* prev = m_node.tail.load(turf::Relaxed);
+            if (prev == NULL) {
+                // The lock appears to be free.
+                if (m_node.tail.compareExchangeStrong(prev, &m_node, turf::Acquire))
+                    return;
+                continue;
+            }
+            Node waiter;
+            waiter.tail.storeNonatomic(waitingMarker());
+            waiter.next.storeNonatomic(NULL);
+            if (!m_node.tail.compareExchangeStrong(prev, &waiter, turf::AcquireRelease))
+                continue;
+            // We're in line. Link in behind our predecessor (possibly the lock node itself), then wait.
+            prev->next.store(&waiter, turf::Release);
+            AdaptiveBackoff backoff;
+            while (waiter.tail.load(turf::Acquire) == waitingMarker()) {
+                backoff.wait();
+            }
+            // We own the lock. Hand our successor, if any, over to the lock node before
+            // our stack node goes away.
+            Node* succ = waiter.next.load(turf::Acquire);
+            if (succ == NULL) {
+                m_node.next.store(NULL, turf::Relaxed);
+                Node* expected = &waiter;
+                if (!m_node.tail.compareExchangeStrong(expected, &m_node, turf::AcquireRelease)) {
+                    // Somebody enqueued behind us in the meantime. Wait for them to link in.
+                    backoff.reset();
+                    while ((succ = waiter.next.load(turf::Acquire)) == NULL) {
+                        backoff.wait();
+                    }
+                    m_node.next.store(succ, turf::Relaxed);
+                }
+            } else {
+                m_node.next.store(succ, turf::Relaxed);
+            }
+            return;
+        }
+    }
+
+public:
+    Mutex_MCS() {
+        m_node.tail.storeNonatomic(NULL);
+        m_node.next.storeNonatomic(NULL);
+    }
+
+    void lock() {
+        Node* expected = NULL;
+        if (!m_node.tail.compareExchangeStrong(expected, &m_node, turf::Acquire))
+            lockSlow();
+    }
+
+    bool tryLock() {
+        Node* expected = NULL;
+        return m_node.tail.compareExchangeStrong(expected, &m_node, turf::Acquire);
+    }
+
+    void unlock() {
+        Node* succ = m_node.next.load(turf::Acquire);
+        if (succ == NULL) {
+            Node* expected = &m_node;
+            if (m_node.tail.compareExchangeStrong(expected, NULL, turf::Release))
+                return;
+            // A waiter is enqueueing. Wait for it to link in.
+            AdaptiveBackoff backoff;
+            while ((succ = m_node.next.load(turf::Acquire)) == NULL) {
+                backoff.wait();
+            }
+        }
+        // Grant the lock to the successor by clearing the flag it spins on.
+        succ->tail.store(NULL, turf::Release);
+    }
+};
+
+} // namespace turf
+
+#endif // TURF_IMPL_MUTEX_MCS_H
@@ -15,6 +15,7 @@
 
 #include <turf/Core.h>
 #include <turf/Atomic.h>
+#include <turf/AdaptiveBackoff.h>
 
 namespace turf {
 
@@ -29,14 +30,24 @@ public:
     }
 
     void lock() {
+        AdaptiveBackoff backoff;
         for (;;) {
             u32 expected = 0;
             if (m_spinLock.compareExchangeStrong(expected, 1, turf::Acquire))
                 break;
-            // FIXME: Implement reusable AdaptiveBackoff class and apply it here
+            // Wait until the lock looks free using plain loads, so that waiters
+            // don't keep stealing the cache line from the owner.
+            do {
+                backoff.wait();
+            } while (m_spinLock.load(turf::Relaxed) != 0);
         }
     }
 
+    bool tryLock() {
+        u32 expected = 0;
+        return m_spinLock.compareExchangeStrong(expected, 1, turf::Acquire);
+    }
+
     void unlock() {
         m_spinLock.store(0, turf::Release);
     }
@@ -0,0 +1,55 @@
+/*------------------------------------------------------------------------
+  Turf: Configurable C++ platform adapter
+  Copyright (c) 2016 Jeff Preshing
+
+  Distributed under the Simplified BSD License.
+  Original location: https://github.com/preshing/turf
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the LICENSE file for more information.
+------------------------------------------------------------------------*/
+
+#ifndef TURF_IMPL_MUTEX_TICKET_H
+#define TURF_IMPL_MUTEX_TICKET_H
+
+#include <turf/Core.h>
+#include <turf/Atomic.h>
+#include <turf/AdaptiveBackoff.h>
+
+namespace turf {
+
+// A fair (FIFO) spinlock. Each waiter takes a ticket with a single fetchAdd, then waits
+// with plain loads until it's being served, so there's no CAS storm on the lock.
+// Works when zero-init at global scope. Not recursive.
+class Mutex_Ticket {
+private:
+    Atomic<u32> m_nextTicket;
+    Atomic<u32> m_nowServing;
+
+public:
+    Mutex_Ticket() : m_nextTicket(0), m_nowServing(0) {
+    }
+
+    void lock() {
+        u32 ticket = m_nextTicket.fetchAdd(1, turf::Relaxed);
+        AdaptiveBackoff backoff;
+        while (m_nowServing.load(turf::Acquire) != ticket) {
+            backoff.wait();
+        }
+    }
+
+    bool tryLock() {
+        u32 ticket = m_nowServing.load(turf::Relaxed);
+        return m_nextTicket.compareExchangeStrong(ticket, ticket + 1, turf::Acquire);
+    }
+
+    void unlock() {
+        // Only the owner modifies m_nowServing.
+        m_nowServing.store(m_nowServing.loadNonatomic() + 1, turf::Release);
+    }
+};
+
+} // namespace turf
+
+#endif // TURF_IMPL_MUTEX_TICKET_H
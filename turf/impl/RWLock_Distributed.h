@@ -0,0 +1,115 @@
+/*------------------------------------------------------------------------
+  Turf: Configurable C++ platform adapter
+  Copyright (c) 2016 Jeff Preshing
+
+  Distributed under the Simplified BSD License.
+  Original location: https://github.com/preshing/turf
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the LICENSE file for more information.
+------------------------------------------------------------------------*/
+
+#ifndef TURF_IMPL_RWLOCK_DISTRIBUTED_H
+#define TURF_IMPL_RWLOCK_DISTRIBUTED_H
+
+#include <turf/Core.h>
+#include <turf/Atomic.h>
+#include <turf/Mutex.h>
+#include <turf/TID.h>
+#include <turf/Util.h>
+#include <turf/AdaptiveBackoff.h>
+
+namespace turf {
+
+//---------------------------------------------------------
+// A writer-preferring RWLock for read-mostly data.
+// Reader counts are spread across slots, one per cache line, chosen by hashing the thread ID.
+// Readers only write to their own slot; a writer raises a flag that turns away new readers,
+// then waits for every slot to drain.
+// This makes lockShared() scale with the number of readers, at the cost of
+// NumSlots cache lines per lock and a slower lockExclusive().
+//---------------------------------------------------------
+class RWLock_Distributed {
+private:
+    static const ureg NumSlots = 64;
+
+    struct Slot {
+        Atomic<u32> readers;
+        u8 padding[TURF_CACHE_LINE_SIZE - sizeof(Atomic<u32>)];
+    };
+
+    u8* m_buffer;
+    Slot* m_slots;
+    Atomic<u32> m_writerActive;
+    Mutex m_writerMutex; // Serializes writers
+
+    Slot& getSlot() {
+        ureg hash = (ureg) util::avalanche((u64) TID::getCurrentThreadID());
+        return m_slots[hash & (NumSlots - 1)];
+    }
+
+    // Not copyable
+    RWLock_Distributed(const RWLock_Distributed&);
+    RWLock_Distributed& operator=(const RWLock_Distributed&);
+
+public:
+    RWLock_Distributed() : m_writerActive(0) {
+        m_buffer = new u8[sizeof(Slot) * NumSlots + TURF_CACHE_LINE_SIZE];
+        m_slots = (Slot*) util::align((ureg) m_buffer, TURF_CACHE_LINE_SIZE);
+        for (ureg i = 0; i < NumSlots; i++)
+            m_slots[i].readers.storeNonatomic(0);
+    }
+
+    ~RWLock_Distributed() {
+        delete[] m_buffer;
+    }
+
+    void lockExclusive() {
+        m_writerMutex.lock();
+        m_writerActive.store(1, turf::Relaxed);
+        // Order the flag store before the slot loads below. Pairs with the fence in lockShared().
+        turf::threadFenceSeqCst();
+        AdaptiveBackoff backoff;
+        for (ureg i = 0; i < NumSlots; i++) {
+            while (m_slots[i].readers.load(turf::Acquire) != 0) {
+                backoff.wait();
+            }
+        }
+    }
+
+    void unlockExclusive() {
+        m_writerActive.store(0, turf::Release);
+        m_writerMutex.unlock();
+    }
+
+    void lockShared() {
+        Slot& slot = getSlot();
+        for (;;) {
+            slot.readers.fetchAdd(1, turf::Relaxed);
+            // Order the slot increment before the flag load below. Pairs with the fence in lockExclusive().
+#if TURF_CPU_X86 || TURF_CPU_X64
+            // Locked RMW instructions are already full barriers on x86/64, so only the compiler needs fencing.
+            turf::signalFenceSeqCst();
+#else
+            turf::threadFenceSeqCst();
+#endif
+            if (m_writerActive.load(turf::Acquire) == 0)
+                return;
+            // A writer is active or waiting. Back out and let it through.
+            slot.readers.fetchSub(1, turf::Release);
+            AdaptiveBackoff backoff;
+            while (m_writerActive.load(turf::Relaxed) != 0) {
+                backoff.wait();
+            }
+        }
+    }
+
+    void unlockShared() {
+        getSlot().readers.fetchSub(1, turf::Release);
+    }
+};
+
+} // namespace turf
+
+#endif // TURF_IMPL_RWLOCK_DISTRIBUTED_H
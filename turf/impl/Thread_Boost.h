@@ -53,6 +53,10 @@ public:
     static void sleepMillis(ureg millis) {
         boost::this_thread::sleep_for(boost::chrono::milliseconds(millis));
     }
+
+    static void yield() {
+        boost::this_thread::yield();
+    }
 };
 
 } // namespace turf
@@ -53,6 +53,10 @@ public:
     static void sleepMillis(ureg millis) {
         std::this_thread::sleep_for(std::chrono::milliseconds(millis));
     }
+
+    static void yield() {
+        std::this_thread::yield();
+    }
 };
 
 } // namespace turf
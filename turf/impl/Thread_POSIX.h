@@ -16,6 +16,7 @@
 #include <turf/Core.h>
 #include <turf/Assert.h>
 #include <pthread.h>
+#include <sched.h>
 #include <time.h>
 #include <string.h>
 
@@ -60,6 +61,10 @@ public:
         m_attached = false;
     }
 
+    static void yield() {
+        sched_yield();
+    }
+
 #if !TURF_TARGET_MINGW
     static void sleepMillis(ureg millis) {
         timespec ts;
@@ -55,6 +55,10 @@ public:
     static void sleepMillis(ureg millis) {
         Sleep(millis);
     }
+
+    static void yield() {
+        SwitchToThread();
+    }
 };
 
 } // namespace turf
@@ -12,21 +12,157 @@
 
 #include <turf/Core.h>
 #include <turf/impl/Trace_Counters.h>
+#include <turf/Util.h>
+#include <turf/Assert.h>
 #include <stdio.h>
+#include <string.h>
+#if !TURF_TARGET_WIN32
+#include <pthread.h>
+#endif
 
 namespace turf {
 
 Trace_Counters Trace_Counters::Instance; // Zero-initialized
 
+TURF_THREAD_LOCAL Trace_Counters::Slab* Trace_Counters::s_slab = NULL;
+
+//---------------------------------------------------------
+// TURF_THREAD_LOCAL variables have no destructors, so each thread that creates a slab also sets a TLS key whose
+// destructor retires the thread's slabs. The key's value is only a flag; the slabs are found through s_slab.
+// The key is created on first use, since groups count events before static constructors run.
+//---------------------------------------------------------
+struct Trace_Counters::ThreadExitHook {
+#if TURF_TARGET_WIN32
+    static DWORD key;
+
+    static void NTAPI onThreadExit(PVOID) {
+        retireThread();
+    }
+#else
+    static pthread_key_t key;
+
+    static void onThreadExit(void*) {
+        retireThread();
+    }
+#endif
+    static bool created; // Protected by Instance.m_mutex
+
+    static void registerCurrentThread() {
+        {
+            LockGuard<Mutex_LazyInit> guard(Instance.m_mutex);
+            if (!created) {
+#if TURF_TARGET_WIN32
+                key = FlsAlloc(onThreadExit);
+                TURF_ASSERT(key != FLS_OUT_OF_INDEXES);
+#else
+                int rc = pthread_key_create(&key, onThreadExit);
+                TURF_ASSERT(rc == 0);
+                TURF_UNUSED(rc);
+#endif
+                created = true;
+            }
+        }
+#if TURF_TARGET_WIN32
+        FlsSetValue(key, (PVOID) 1);
+#else
+        pthread_setspecific(key, (void*) 1);
+#endif
+    }
+};
+
+#if TURF_TARGET_WIN32
+DWORD Trace_Counters::ThreadExitHook::key;
+#else
+pthread_key_t Trace_Counters::ThreadExitHook::key;
+#endif
+bool Trace_Counters::ThreadExitHook::created;
+
 void Trace_Counters::addGroup(TraceGroup* group) {
+    ureg firstSlot = m_numSlots.fetchAdd(group->m_numCounters, turf::Relaxed) + 1;
+    for (ureg i = 0; i < group->m_numCounters; i++)
+        group->m_counters[i].slot = firstSlot + i;
     TraceGroup* oldHead = m_firstGroup.load(turf::Relaxed);
     do {
         group->m_next = oldHead;
-    } while (!m_firstGroup.compareExchangeWeak(oldHead, group, turf::Relaxed, turf::Relaxed));
+    } while (!m_firstGroup.compareExchangeWeak(oldHead, group, turf::Release, turf::Relaxed));
+}
+
+Trace_Counters::Slab* Trace_Counters::createSlab() {
+    // Called the first time a thread counts something, and again if groups were registered
+    // since its slab was created. In that case the old slab keeps the counts it already has.
+    if (!s_slab)
+        ThreadExitHook::registerCurrentThread();
+    ureg numSlots = Instance.m_numSlots.load(turf::Relaxed) + 1;
+    LockGuard<Mutex_LazyInit> guard(Instance.m_mutex);
+    // Reuse the slab of a thread that exited. Slots are never unregistered, so slabs that are too small now will
+    // always be too small; free them.
+    Slab* slab;
+    while ((slab = Instance.m_freeSlabs) != NULL) {
+        Instance.m_freeSlabs = slab->next;
+        if (slab->numSlots >= numSlots)
+            break;
+        delete[] slab->buffer;
+    }
+    if (slab) {
+        for (ureg i = 0; i < slab->numSlots; i++)
+            slab->counts[i].storeNonatomic(0);
+    } else {
+        // Pad to whole cache lines so that no two threads' slabs share a line.
+        ureg size = turf::util::align(sizeof(Slab) + numSlots * sizeof(turf::Atomic<u32>), TURF_CACHE_LINE_SIZE);
+        u8* buffer = new u8[size + TURF_CACHE_LINE_SIZE];
+        memset(buffer, 0, size + TURF_CACHE_LINE_SIZE);
+        slab = (Slab*) turf::util::align((ureg) buffer, TURF_CACHE_LINE_SIZE);
+        slab->numSlots = numSlots;
+        slab->counts = (turf::Atomic<u32>*) (slab + 1);
+        slab->buffer = buffer;
+    }
+    slab->olderInThread = s_slab;
+    slab->next = Instance.m_firstSlab;
+    Instance.m_firstSlab = slab;
+    s_slab = slab;
+    return slab;
+}
+
+void Trace_Counters::retireThread() {
+    Slab* slab = s_slab;
+    s_slab = NULL;
+    if (!slab)
+        return;
+    LockGuard<Mutex_LazyInit> guard(Instance.m_mutex);
+    // The newest slab has the most slots.
+    if (slab->numSlots > Instance.m_numRetiredSlots) {
+        u64* retiredCounts = new u64[slab->numSlots];
+        memset(retiredCounts, 0, slab->numSlots * sizeof(u64));
+        if (Instance.m_retiredCounts)
+            memcpy(retiredCounts, Instance.m_retiredCounts, Instance.m_numRetiredSlots * sizeof(u64));
+        delete[] Instance.m_retiredCounts;
+        Instance.m_retiredCounts = retiredCounts;
+        Instance.m_numRetiredSlots = slab->numSlots;
+    }
+    for (; slab; slab = slab->olderInThread) {
+        for (ureg i = 0; i < slab->numSlots; i++)
+            Instance.m_retiredCounts[i] += slab->counts[i].load(turf::Relaxed);
+        Slab** link = &Instance.m_firstSlab;
+        while (*link != slab)
+            link = &(*link)->next;
+        *link = slab->next;
+        slab->next = Instance.m_freeSlabs;
+        Instance.m_freeSlabs = slab;
+    }
+}
+
+u64 Trace_Counters::getCount(ureg slot) {
+    LockGuard<Mutex_LazyInit> guard(m_mutex);
+    u64 count = (slot < m_numRetiredSlots) ? m_retiredCounts[slot] : 0;
+    for (Slab* slab = m_firstSlab; slab; slab = slab->next) {
+        if (slot < slab->numSlots)
+            count += slab->counts[slot].load(turf::Relaxed);
+    }
+    return count;
 }
 
 void Trace_Counters::dumpStats() {
-    TraceGroup* group = m_firstGroup.load(turf::Relaxed);
+    TraceGroup* group = m_firstGroup.load(turf::Acquire);
     for (; group; group = group->m_next) {
         group->dumpIfUsed();
     }
@@ -35,13 +171,13 @@ void Trace_Counters::dumpStats() {
 void TraceGroup::dump() {
     printf("--------------- %s\n", m_name);
     for (ureg i = 0; i < m_numCounters; i++) {
-        printf("%12" TURF_U32D ": %s\n", m_counters[i].count.load(turf::Relaxed), m_counters[i].str);
+        printf("%12" TURF_U64D ": %s\n", Trace_Counters::Instance.getCount(m_counters[i].slot), m_counters[i].str);
     }
 }
 
 void TraceGroup::dumpIfUsed() {
     for (ureg i = 0; i < m_numCounters; i++) {
-        if (m_counters[i].count.load(turf::Relaxed)) {
+        if (Trace_Counters::Instance.getCount(m_counters[i].slot)) {
             dump();
             break;
         }
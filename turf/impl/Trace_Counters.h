@@ -15,26 +15,64 @@
 
 #include <turf/Core.h>
 #include <turf/Atomic.h>
+#include <turf/impl/Mutex_LazyInit.h>
 
 namespace turf {
 
 class TraceGroup;
 
+//---------------------------------------------------------
+// Counts TURF_TRACE events.
+// Each thread increments its own slab of counters, so counting doesn't share any cache lines
+// between threads. TraceGroup::dump() adds up the slabs of every thread.
+// When a thread exits, its counts are added to a retired total and its slabs are reused by later threads.
+//---------------------------------------------------------
 class Trace_Counters {
 private:
+    // One per thread, plus older ones if groups were registered after the thread started counting.
+    // Only the owning thread modifies the counts.
+    struct Slab {
+        Slab* next;          // In m_firstSlab while its thread is running, then in m_freeSlabs
+        Slab* olderInThread; // The slab the same thread used before this one
+        ureg numSlots;
+        turf::Atomic<u32>* counts;
+        u8* buffer; // Holds the slab and its counts
+    };
+
     turf::Atomic<TraceGroup*> m_firstGroup;
+    turf::Atomic<ureg> m_numSlots; // Slot 0 is reserved for counters whose group isn't registered yet
+    turf::Mutex_LazyInit m_mutex;  // Protects the members below
+    Slab* m_firstSlab;
+    Slab* m_freeSlabs;
+    u64* m_retiredCounts; // Counts of the threads that exited
+    ureg m_numRetiredSlots;
+
+    static TURF_THREAD_LOCAL Slab* s_slab;
+
+    struct ThreadExitHook; // Calls retireThread when a thread that has a slab exits
+
+    TURF_NO_INLINE static Slab* createSlab();
+    static void retireThread();
 
 public:
     void addGroup(TraceGroup* group);
+    u64 getCount(ureg slot);
     void dumpStats();
 
+    static void increment(ureg slot) {
+        Slab* slab = s_slab;
+        if (!slab || slot >= slab->numSlots)
+            slab = createSlab();
+        slab->counts[slot].store(slab->counts[slot].load(turf::Relaxed) + 1, turf::Relaxed);
+    }
+
     static Trace_Counters Instance; // Zero-initialized
 };
 
 class TraceGroup {
 public:
     struct Counter {
-        turf::Atomic<u32> count;
+        ureg slot; // Assigned when the group is registered
         const char* str;
     };
 
@@ -61,7 +99,7 @@ public:
 #define TURF_TRACE_DEFINE_END(group, count)   }; \
                                               turf::TraceGroup TraceGroup_##group(#group, Trace_##group, count);
 #define TURF_TRACE(group, index, msg, param1, param2) \
-    Trace_##group[index].count.fetchAdd(1, turf::Relaxed)
+    turf::Trace_Counters::increment(Trace_##group[index].slot)
 // clang-format on
 
 } // namespace turf
@@ -10,82 +10,391 @@
   See the LICENSE file for more information.
 ------------------------------------------------------------------------*/
 
-#include <memory>
+#include <algorithm>
 #include <turf/impl/Trace_MemLog.h>
 #include <stdio.h>
+#include <string.h>
 #include <turf/Util.h>
+#include <turf/Assert.h>
 
 namespace turf {
 
 Trace_MemLog Trace_MemLog::Instance;
 
-Trace_MemLog::Trace_MemLog() : m_head(new Page), m_tail(m_head), m_numPages(1) {
+TURF_THREAD_LOCAL Trace_MemLog::ThreadLog* Trace_MemLog::s_threadLog = NULL;
+
+Trace_MemLog::Trace_MemLog() : m_pageBytes(0), m_threadLogs(NULL), m_freePages(NULL), m_numPages(0) {
+    configure(Params());
 }
 
 Trace_MemLog::~Trace_MemLog() {
     // Pages are not cleaned up
 }
 
-Trace_MemLog::Event* Trace_MemLog::allocateEventFromNewPage() {
+void Trace_MemLog::configure(const Params& params) {
+    TURF_ASSERT(params.eventsPerPage > 0);
+    TURF_ASSERT(params.maxPagesPerThread > 0);
+    ureg allocAlignment;
+    ureg osPageSize = MemPage::getPageSize(allocAlignment);
+    ureg pageBytes = turf::util::align(sizeof(Page) + params.eventsPerPage * sizeof(Event), osPageSize);
+
+    turf::LockGuard<turf::Mutex> lock(m_mutex);
+    releaseAllPages();
+    if (pageBytes != m_pageBytes) {
+        // Existing pages are the wrong size. Give them back to the OS.
+        while (Page* page = m_freePages) {
+            m_freePages = page->next;
+            MemPage::free(page, m_pageBytes);
+        }
+        m_numPages = 0;
+    }
+    m_params = params;
+    m_pageBytes = pageBytes;
+    while (m_numPages < params.reservePages) {
+        void* mem;
+        if (!MemPage::alloc(mem, m_pageBytes))
+            break; // Logging will try again, and drop events if it can't get pages either
+        Page* page = (Page*) mem;
+        page->next = m_freePages;
+        m_freePages = page;
+        m_numPages++;
+    }
+}
+
+void Trace_MemLog::clear() {
     turf::LockGuard<turf::Mutex> lock(m_mutex);
-    // Double-checked locking:
-    // Check again whether the current page is full. Another thread may have called
-    // allocateEventFromNewPage and created a new page by the time we get take the lock.
-    Page* oldTail = m_tail.loadNonatomic();
-    if (oldTail->index.load(turf::Relaxed) < EventsPerPage) {
-        sreg index = oldTail->index.fetchAdd(1, turf::Relaxed);
-        // Yes! We got a slot on this page.
-        if (index < EventsPerPage)
-            return &oldTail->events[index];
-    }
-
-    // OK, we're definitely out of space. It's up to us to allocate a new page.
-    Page* newTail = new Page;
-    // Reserve the first slot.
-    newTail->index.storeNonatomic(1);
-    // A plain non-atomic move to oldTail->next is fine because there are no other writers here,
-    // and nobody is supposed to read the logged contents until all logging is complete.
-    oldTail->next = newTail;
-    // m_tail must be written atomically because it is read concurrently from other threads.
-    // We also use release/consume semantics so that its constructed contents are visible to other threads.
-    // Again, very much like the double-checked locking pattern.
-    m_tail.store(newTail, turf::Release);
-    if (m_numPages >= MaxNumPages) {
-        Page* oldHead = m_head;
-        m_head = oldHead->next;
-        delete oldHead;
+    releaseAllPages();
+}
+
+void Trace_MemLog::releaseAllPages() {
+    // m_mutex must be locked.
+    for (ThreadLog* threadLog = m_threadLogs; threadLog; threadLog = threadLog->next) {
+        if (threadLog->tail) {
+            threadLog->tail->next = m_freePages;
+            m_freePages = threadLog->head;
+        }
+        threadLog->head = NULL;
+        threadLog->tail = NULL;
+        threadLog->numPages = 0;
+        threadLog->numDropped = 0;
+        threadLog->isFull = false;
+    }
+}
+
+Trace_MemLog::ThreadLog* Trace_MemLog::getThreadLog() {
+    turf::TID::TID tid = turf::TID::getCurrentThreadID();
+    turf::LockGuard<turf::Mutex> lock(m_mutex);
+    // If a previous thread with the same ID has exited, pick up where its log left off.
+    ThreadLog* threadLog = m_threadLogs;
+    while (threadLog && threadLog->tid != tid)
+        threadLog = threadLog->next;
+    if (!threadLog) {
+        threadLog = new ThreadLog(this, tid);
+        threadLog->next = m_threadLogs;
+        m_threadLogs = threadLog;
+    }
+    s_threadLog = threadLog;
+    return threadLog;
+}
+
+Trace_MemLog::Page* Trace_MemLog::allocatePage() {
+    // m_mutex must be locked.
+    Page* page = m_freePages;
+    if (page) {
+        m_freePages = page->next;
     } else {
+        if (m_numPages >= m_params.maxPages)
+            return NULL;
+        void* mem;
+        if (!MemPage::alloc(mem, m_pageBytes))
+            return NULL;
+        page = (Page*) mem;
         m_numPages++;
     }
+    page->next = NULL;
+    page->count.storeNonatomic(0);
+    return page;
+}
+
+Trace_MemLog::Page* Trace_MemLog::stealOldestPage() {
+    // m_mutex must be locked.
+    // Only a log's head page can be taken, and only if the log has moved on to another page. That page is complete,
+    // and its owner, alive or not, will only touch the log again under m_mutex.
+    ThreadLog* victim = NULL;
+    for (ThreadLog* threadLog = m_threadLogs; threadLog; threadLog = threadLog->next) {
+        if (!threadLog->head || threadLog->head == threadLog->tail)
+            continue;
+#if TURF_TRACE_MEMLOG_TIMESTAMPS
+        if (!victim || threadLog->head->events()[0].time < victim->head->events()[0].time)
+            victim = threadLog;
+#else
+        // Without timestamps, take from whichever thread has the most pages.
+        if (!victim || threadLog->numPages > victim->numPages)
+            victim = threadLog;
+#endif
+    }
+    if (!victim)
+        return NULL;
+    Page* page = victim->head;
+    victim->head = page->next;
+    victim->numPages--;
+    page->next = NULL;
+    page->count.store(0, turf::Relaxed);
+    return page;
+}
+
+Trace_MemLog::Page* Trace_MemLog::advancePage(ThreadLog* threadLog) {
+    // Only the owning thread gets here, once per page. The lock lets other threads take this thread's oldest page.
+    if (threadLog->isFull) {
+        threadLog->numDropped++;
+        return NULL;
+    }
+    turf::LockGuard<turf::Mutex> lock(m_mutex);
+    Page* page = NULL;
+    if (threadLog->numPages < m_params.maxPagesPerThread) {
+        page = allocatePage();
+        if (!page && m_params.policy == OverwriteOldest) {
+            // Every page is in use. Take the oldest one, which may belong to a thread that has exited.
+            page = stealOldestPage();
+        }
+        if (page)
+            threadLog->numPages++;
+    }
+    if (!page) {
+        // Out of pages.
+        if (m_params.policy == StopWhenFull) {
+            threadLog->isFull = true;
+            threadLog->numDropped++;
+            return NULL;
+        }
+        if (!threadLog->head) {
+            // Every other log is down to the page it's writing. Try again on the next event.
+            threadLog->numDropped++;
+            return NULL;
+        }
+        // Overwrite the oldest page.
+        page = threadLog->head;
+        if (page == threadLog->tail) {
+            page->count.store(0, turf::Relaxed);
+            return page;
+        }
+        threadLog->head = page->next;
+        page->next = NULL;
+        page->count.store(0, turf::Relaxed);
+    }
+    if (threadLog->tail)
+        threadLog->tail->next = page;
+    else
+        threadLog->head = page;
+    threadLog->tail = page;
+    return page;
+}
 
-    // Return the reserved slot.
-    return &newTail->events[0];
+Trace_MemLog::Iterator::Iterator(Trace_MemLog& log) : m_cursors(NULL), m_numCursors(0), m_maxCursors(0) {
+    turf::LockGuard<turf::Mutex> lock(log.m_mutex);
+    ureg numThreads = 0;
+    for (ThreadLog* threadLog = log.m_threadLogs; threadLog; threadLog = threadLog->next)
+        numThreads++;
+    allocCursors(numThreads);
+    if (!m_cursors)
+        return;
+    ureg threadNum = 0;
+    for (ThreadLog* threadLog = log.m_threadLogs; threadLog; threadLog = threadLog->next)
+        push(threadLog->head, 0, threadNum++);
+}
+
+Trace_MemLog::Iterator::Iterator(const Iterator& other) : m_cursors(NULL), m_numCursors(0), m_maxCursors(0) {
+    *this = other;
+}
+
+Trace_MemLog::Iterator::~Iterator() {
+    if (m_cursors)
+        MemPage::free(m_cursors, m_maxCursors * sizeof(Cursor));
+}
+
+Trace_MemLog::Iterator& Trace_MemLog::Iterator::operator=(const Iterator& other) {
+    if (this != &other) {
+        if (m_cursors)
+            MemPage::free(m_cursors, m_maxCursors * sizeof(Cursor));
+        m_cursors = NULL;
+        m_numCursors = 0;
+        m_maxCursors = 0;
+        if (other.m_numCursors > 0) {
+            allocCursors(other.m_numCursors);
+            if (m_cursors) {
+                memcpy(m_cursors, other.m_cursors, other.m_numCursors * sizeof(Cursor));
+                m_numCursors = other.m_numCursors;
+            }
+        }
+    }
+    return *this;
+}
+
+void Trace_MemLog::Iterator::allocCursors(ureg maxCursors) {
+    void* mem;
+    if (maxCursors > 0 && MemPage::alloc(mem, maxCursors * sizeof(Cursor))) {
+        m_cursors = (Cursor*) mem;
+        m_maxCursors = maxCursors;
+    }
+}
+
+void Trace_MemLog::Iterator::push(Page* page, ureg index, ureg threadNum) {
+    // Skip past the end of each page, and any empty pages.
+    while (page && index >= page->count.load(turf::Relaxed)) {
+        page = page->next;
+        index = 0;
+    }
+    if (page) {
+        TURF_ASSERT(m_numCursors < m_maxCursors);
+        Cursor cursor = {page, index, threadNum};
+        m_cursors[m_numCursors++] = cursor;
+        std::push_heap(m_cursors, m_cursors + m_numCursors, isLater);
+    }
+}
+
+Trace_MemLog::Iterator& Trace_MemLog::Iterator::operator++() {
+    std::pop_heap(m_cursors, m_cursors + m_numCursors, isLater);
+    Cursor cursor = m_cursors[--m_numCursors];
+    push(cursor.page, cursor.index + 1, cursor.threadNum);
+    return *this;
 }
 
 void Trace_MemLog::dumpStats() {
     ureg numEvents = 0;
+    ureg numDropped = 0;
+    ureg numThreads = 0;
+    ureg numPages = 0;
     {
         turf::LockGuard<turf::Mutex> lock(m_mutex);
-        numEvents = (m_numPages - 1) * EventsPerPage + m_tail.load(turf::Consume)->index.load(turf::Relaxed);
+        for (ThreadLog* threadLog = m_threadLogs; threadLog; threadLog = threadLog->next) {
+            for (Page* page = threadLog->head; page; page = page->next)
+                numEvents += page->count.load(turf::Relaxed);
+            numDropped += threadLog->numDropped;
+            numThreads++;
+        }
+        numPages = m_numPages;
     }
-    printf("%" TURF_UREGD " events logged\n", numEvents);
+    printf("%" TURF_UREGD " events logged by %" TURF_UREGD " threads, %" TURF_UREGD " dropped, %" TURF_UREGD
+           " pages allocated\n",
+           numEvents, numThreads, numDropped, numPages);
 }
 
-void Trace_MemLog::dumpEntireLog(const char* path, ureg startPage) {
-    turf::LockGuard<turf::Mutex> lock(m_mutex);
+bool Trace_MemLog::dumpEntireLog(const char* path) {
     FILE* f = fopen(path, "w");
-    for (Page* page = m_head; page; page = page->next) {
-        if (startPage > 0) {
-            startPage--;
-            continue;
+    if (!f)
+        return false;
+#if TURF_TRACE_MEMLOG_TIMESTAMPS
+    // Times are in microseconds, relative to the first event, followed by the time since the previous event.
+    // They're computed in double from tick counts; a float loses microseconds after a few seconds.
+    double microsecondsPerTick = 1e6 / (double) Timer::Converter().toDuration(1.f);
+    Timer::Point start;
+    Timer::Point prev;
+    bool first = true;
+#endif
+    for (Iterator iter = begin(); iter != end(); ++iter) {
+        const Event& evt = *iter;
+#if TURF_TRACE_MEMLOG_TIMESTAMPS
+        if (first) {
+            start = evt.time;
+            prev = evt.time;
+            first = false;
+        }
+        fprintf(f, "%14.3f %+10.3f ", (double) (s64)(evt.time - start) * microsecondsPerTick,
+                (double) (s64)(evt.time - prev) * microsecondsPerTick);
+        prev = evt.time;
+#endif
+        fprintf(f, "[%" TURF_U64X "] %" TURF_UPTRX " %" TURF_UPTRX " %s\n", (u64) evt.tid, evt.param1, evt.param2, evt.msg);
+    }
+    bool ok = !ferror(f);
+    ok &= (fclose(f) == 0);
+    return ok;
+}
+
+bool Trace_MemLog::dumpEntireLogBinary(const char* path) {
+    ureg numEvents = 0;
+    {
+        turf::LockGuard<turf::Mutex> lock(m_mutex);
+        for (ThreadLog* threadLog = m_threadLogs; threadLog; threadLog = threadLog->next) {
+            for (Page* page = threadLog->head; page; page = page->next)
+                numEvents += page->count.load(turf::Relaxed);
+        }
+    }
+    // Scratch space comes from MemPage, so that dumping doesn't disturb the heap being traced.
+    // It holds the records, the distinct message strings in order, and an open-addressed table of string indices.
+    ureg numSlots = util::roundUpPowerOf2((u64) util::max<ureg>(numEvents * 2, 16));
+    ureg recordsSize = util::align(sizeof(FileRecord) * numEvents, 16);
+    ureg stringsSize = util::align(sizeof(const char*) * numEvents, 16);
+    ureg scratchSize = recordsSize + stringsSize + sizeof(StringSlot) * numSlots;
+    void* mem;
+    if (!MemPage::alloc(mem, scratchSize))
+        return false;
+    FileRecord* records = (FileRecord*) mem;
+    const char** strings = (const char**) ((char*) mem + recordsSize);
+    StringSlot* slots = (StringSlot*) ((char*) mem + recordsSize + stringsSize);
+    for (ureg i = 0; i < numSlots; i++)
+        slots[i].str = NULL;
+
+    ureg numRecords = 0;
+    u32 numStrings = 0;
+    u32 stringTableSize = 0;
+#if TURF_TRACE_MEMLOG_TIMESTAMPS
+    Timer::Point start;
+#endif
+    for (Iterator iter = begin(); iter != end() && numRecords < numEvents; ++iter) {
+        const Event& evt = *iter;
+        const char* msg = evt.msg ? evt.msg : "";
+        // Messages are usually string literals, so they're matched by address.
+        ureg s = (ureg) util::avalanche((u64) (uptr) msg) & (numSlots - 1);
+        while (slots[s].str && slots[s].str != msg)
+            s = (s + 1) & (numSlots - 1);
+        if (!slots[s].str) {
+            slots[s].str = msg;
+            slots[s].index = numStrings;
+            strings[numStrings++] = msg;
+            stringTableSize += (u32) strlen(msg) + 1;
         }
-        ureg limit = turf::util::min<ureg>(EventsPerPage, page->index.load(turf::Relaxed));
-        for (ureg i = 0; i < limit; i++) {
-            const Event& evt = page->events[i];
-            fprintf(f, "[%" TURF_U64X "] %" TURF_UPTRX " %" TURF_UPTRX " %s\n", (u64) evt.tid, evt.param1, evt.param2, evt.msg);
+        FileRecord& record = records[numRecords];
+#if TURF_TRACE_MEMLOG_TIMESTAMPS
+        if (numRecords == 0)
+            start = evt.time;
+        record.time = (u64)(evt.time - start);
+#else
+        record.time = 0;
+#endif
+        record.tid = (u64) evt.tid;
+        record.param1 = evt.param1;
+        record.param2 = evt.param2;
+        record.msgIndex = slots[s].index;
+        record.padding = 0;
+        numRecords++;
+    }
+
+    FileHeader header;
+    header.magic = FileMagic;
+    header.version = FileVersion;
+    header.numStrings = numStrings;
+    header.stringTableSize = stringTableSize;
+    header.numRecords = numRecords;
+#if TURF_TRACE_MEMLOG_TIMESTAMPS
+    header.ticksPerSecond = (double) Timer::Converter().toDuration(1.f);
+#else
+    header.ticksPerSecond = 0;
+#endif
+
+    bool ok = false;
+    FILE* f = fopen(path, "wb");
+    if (f) {
+        ok = (fwrite(&header, sizeof(header), 1, f) == 1);
+        for (u32 i = 0; ok && i < numStrings; i++) {
+            ureg length = strlen(strings[i]) + 1;
+            ok = (fwrite(strings[i], 1, length, f) == length);
         }
+        if (ok && numRecords > 0)
+            ok = (fwrite(records, sizeof(FileRecord), numRecords, f) == numRecords);
+        ok &= (fclose(f) == 0);
     }
-    fclose(f);
+    MemPage::free(mem, scratchSize);
+    return ok;
 }
 
 } // namespace turf
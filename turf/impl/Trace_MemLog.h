@@ -16,19 +16,42 @@
 #include <turf/Core.h>
 #include <turf/TID.h>
 #include <turf/Mutex.h>
-#include <memory>
+#include <turf/CPUTimer.h>
+#include <turf/MemPage.h>
+#if TURF_COMPILER_GCC && (TURF_CPU_X86 || TURF_CPU_X64)
+#include <turf/impl/CPUTimer_GCC.h>
+#endif
 #include <turf/Atomic.h>
 
+// Set to 0 in turf_userconfig.h to log events without timestamps.
+// Without timestamps, iterators and dumps visit each thread's events in turn instead of interleaving them.
+#ifndef TURF_TRACE_MEMLOG_TIMESTAMPS
+#define TURF_TRACE_MEMLOG_TIMESTAMPS 1
+#endif
+
 namespace turf {
 
 //---------------------------------------------------------
 // Logs TURF_TRACE events to memory.
-// Iterator should only be used after logging is complete.
+// Each thread logs to its own ring of pages, so the hot path touches no shared atomics.
+// Pages are allocated with MemPage and recycled through a free list; they're never freed.
+// Capacity and the policy when a thread runs out of pages are set by configure().
+// Iterator merges the per-thread logs by timestamp, and should only be used after logging is complete.
 // Useful for post-mortem debugging and for validating tests.
 //---------------------------------------------------------
 class Trace_MemLog {
 public:
+// Timestamps come straight from the timestamp counter where possible, since it's the cheapest clock.
+#if TURF_COMPILER_GCC && (TURF_CPU_X86 || TURF_CPU_X64)
+    typedef turf::CPUTimer_GCC Timer;
+#else
+    typedef turf::CPUTimer Timer;
+#endif
+
     struct Event {
+#if TURF_TRACE_MEMLOG_TIMESTAMPS
+        Timer::Point time;
+#endif
         turf::TID::TID tid;
         const char* msg;
         uptr param1;
@@ -38,93 +61,189 @@ public:
         }
     };
 
-private:
-    static const ureg MaxNumPages = 4;
-    static const ureg EventsPerPage = 16384;
+    // Binary dump format, in native byte order:
+    // A FileHeader, then numStrings null-terminated strings (stringTableSize bytes in total),
+    // then numRecords FileRecords. Each record's msgIndex selects a string from the table.
+    static const u32 FileMagic = 0x4c4d5254; // "TRML"
+    static const u32 FileVersion = 1;
+
+    struct FileHeader {
+        u32 magic;
+        u32 version;
+        u32 numStrings;
+        u32 stringTableSize;
+        u64 numRecords;
+        double ticksPerSecond; // Zero if events have no timestamps
+    };
+
+    struct FileRecord {
+        u64 time; // Ticks since the first record
+        u64 tid;
+        u64 param1;
+        u64 param2;
+        u32 msgIndex;
+        u32 padding;
+    };
+
+    enum Policy {
+        // When a thread reaches maxPagesPerThread, it overwrites its own oldest page. When all maxPages are in use,
+        // it takes the oldest complete page of any thread, including threads that have exited.
+        OverwriteOldest,
+        StopWhenFull, // When a thread runs out of pages, its subsequent events are dropped.
+    };
+
+    struct Params {
+        ureg eventsPerPage;
+        ureg maxPagesPerThread;
+        ureg maxPages;      // Total across all threads
+        ureg reservePages;  // Pages allocated up front, so the first pages don't have to be allocated while logging
+        Policy policy;
+
+        Params() : eventsPerPage(4096), maxPagesPerThread(4), maxPages(256), reservePages(0), policy(OverwriteOldest) {
+        }
+    };
 
+private:
     struct Page {
         Page* next;
-        turf::Atomic<sreg> index; // This can exceed EVENTS_PER_PAGE, but it's harmless. Just means page is full.
-        Event events[EventsPerPage];
+        turf::Atomic<ureg> count; // Only modified by the owning thread.
 
-        Page() : next(NULL), index(0) {
+        Event* events() {
+            return (Event*) (this + 1);
         }
     };
 
-    // Store events in a linked list of pages.
-    // Mutex is only locked when it's time to allocate a new page.
+    // Maps a message to its index in a binary dump's string table.
+    struct StringSlot {
+        const char* str;
+        u32 index;
+    };
+
+    // Owned by a single thread. Other threads may take its head page under m_mutex, and otherwise only read it once
+    // logging is complete.
+    struct ThreadLog {
+        ThreadLog* next; // Next log in m_threadLogs
+        Trace_MemLog* owner;
+        turf::TID::TID tid;
+        Page* head; // Oldest page
+        Page* tail; // Page currently being written
+        ureg numPages;
+        ureg numDropped;
+        bool isFull; // Only set under StopWhenFull
+
+        ThreadLog(Trace_MemLog* owner, turf::TID::TID tid)
+            : next(NULL), owner(owner), tid(tid), head(NULL), tail(NULL), numPages(0), numDropped(0), isFull(false) {
+        }
+    };
+
+    // Mutex is only locked when a thread logs its first event, when it moves on to a new page, and while dumping.
+    // Each thread only modifies its own head and tail under the mutex, so that other threads can take its oldest page.
     turf::Mutex m_mutex;
-    Page* m_head;
-    turf::Atomic<Page*> m_tail;
-    ureg m_numPages; // Protected by m_mutex
+    Params m_params;
+    ureg m_pageBytes;
+    ThreadLog* m_threadLogs; // Protected by m_mutex
+    Page* m_freePages;       // Protected by m_mutex
+    ureg m_numPages;         // Protected by m_mutex; includes free pages
+
+    static TURF_THREAD_LOCAL ThreadLog* s_threadLog;
 
-    Event* allocateEventFromNewPage();
+    ThreadLog* getThreadLog();
+    Page* allocatePage(); // Returns NULL at maxPages, or if MemPage can't map another page
+    Page* stealOldestPage();
+    void releaseAllPages();
+    TURF_NO_INLINE Page* advancePage(ThreadLog* threadLog);
 
 public:
     Trace_MemLog();
     ~Trace_MemLog();
 
+    // Must only be called when no other threads are logging. Discards all logged events.
+    void configure(const Params& params);
+    // Must only be called when no other threads are logging. Returns all pages to the free list.
+    void clear();
+
     void log(const char* msg, uptr param1, uptr param2) {
         turf::signalFenceSeqCst(); // Compiler barrier
-        Page* page = m_tail.load(turf::Consume);
-        Event* evt;
-        sreg index = page->index.fetchAdd(1, turf::Relaxed);
-        if (index < EventsPerPage)
-            evt = &page->events[index];
-        else
-            evt = allocateEventFromNewPage(); // Double-checked locking is performed inside here.
-        evt->tid = turf::TID::getCurrentThreadID();
+        ThreadLog* threadLog = s_threadLog;
+        if (!threadLog || threadLog->owner != this)
+            threadLog = getThreadLog();
+        Page* page = threadLog->tail;
+        ureg index;
+        if (!page || (index = page->count.load(turf::Relaxed)) >= m_params.eventsPerPage) {
+            page = advancePage(threadLog);
+            if (!page)
+                return; // Dropped
+            index = 0;
+        }
+        Event* evt = &page->events()[index];
+#if TURF_TRACE_MEMLOG_TIMESTAMPS
+        evt->time = Timer::get();
+#endif
+        evt->tid = threadLog->tid;
         evt->msg = msg;
         evt->param1 = param1;
         evt->param2 = param2;
+        page->count.store(index + 1, turf::Relaxed);
         turf::signalFenceSeqCst(); // Compiler barrier
     }
 
     // Iterators are meant to be used only after all logging is complete.
+    // Visits the events of every thread in timestamp order.
+    // Like the dumps, doesn't allocate from the heap being traced. If MemPage can't map the cursors, visits nothing.
     friend class Iterator;
     class Iterator {
     private:
-        Page* m_page;
-        sreg m_index;
+        struct Cursor {
+            Page* page;
+            ureg index;
+            ureg threadNum;
+        };
+        Cursor* m_cursors; // Min-heap ordered by the timestamp of each cursor's current event, in MemPage memory
+        ureg m_numCursors;
+        ureg m_maxCursors;
 
-    public:
-        Iterator(Page* p, sreg i) : m_page(p), m_index(i) {
+        static bool isLater(const Cursor& a, const Cursor& b) {
+#if TURF_TRACE_MEMLOG_TIMESTAMPS
+            return b.page->events()[b.index].time < a.page->events()[a.index].time;
+#else
+            return a.threadNum > b.threadNum;
+#endif
         }
+        void allocCursors(ureg maxCursors);
+        void push(Page* page, ureg index, ureg threadNum);
 
-        Iterator& operator++() {
-            m_index++;
-            if (m_index >= EventsPerPage) {
-                Page* next = m_page->next;
-                if (next) {
-                    m_page = next;
-                    m_index = 0;
-                } else {
-                    m_index = m_page->index.loadNonatomic();
-                }
-            }
-            return *this;
+    public:
+        Iterator() : m_cursors(NULL), m_numCursors(0), m_maxCursors(0) {
         }
+        Iterator(Trace_MemLog& log);
+        Iterator(const Iterator& other);
+        ~Iterator();
+        Iterator& operator=(const Iterator& other);
+        Iterator& operator++();
 
         bool operator!=(const Iterator& other) const {
-            return (m_page != other.m_page) || (m_index != other.m_index);
+            return (m_numCursors == 0) != (other.m_numCursors == 0);
         }
 
         const Event& operator*() const {
-            return m_page->events[m_index];
+            const Cursor& cursor = m_cursors[0];
+            return cursor.page->events()[cursor.index];
         }
     };
 
     Iterator begin() {
-        return Iterator(m_head, 0);
+        return Iterator(*this);
     }
 
     Iterator end() {
-        Page* tail = m_tail.load(turf::Relaxed);
-        return Iterator(tail, tail->index.loadNonatomic());
+        return Iterator();
     }
 
     void dumpStats();
-    void dumpEntireLog(const char* path, ureg startPage = 0);
+    // The dumps return false if the file can't be written.
+    bool dumpEntireLog(const char* path);
+    // Much faster and more compact than dumpEntireLog. Decode it using the MemLogDecoder sample.
+    bool dumpEntireLogBinary(const char* path);
 
     static Trace_MemLog Instance;
 };